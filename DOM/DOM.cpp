@@ -9,6 +9,7 @@
 
 #include "node.h"
 #include "parser.h"
+#include "document.h"
 #include "dom_util.h"
 #include "input_handler.h"
 #include "html_templates.h"
@@ -17,13 +18,52 @@
 #include "event_dispatcher.h"
 #include "selector.h"
 #include "selector_matcher.h"
+#include "benchmark.h"
+#include "self_check.h"
+#include "node_visitor.h"
 #include <chrono>
 
-int main() {
+// Node counts for the element count and statistics menu entries
+class NodeStats : public NodeVisitor<NodeStats> {
+public:
+    std::map<std::string, int> counts;
+    int elements = 0, texts = 0, cdatas = 0, maxDepth = 0;
+
+    bool visitElement(ElementNode* elementNode) {
+        counts[std::string(elementNode->getTagName())]++;
+        elements++;
+        return reached();
+    }
+
+    bool visitText(TextNode*) {
+        counts["#text"]++;
+        texts++;
+        return reached();
+    }
+
+    bool visitCDATA(CDATANode*) {
+        counts["#cdata"]++;
+        cdatas++;
+        return reached();
+    }
+
+private:
+    // Depth counts the nodes on the path from the root, root included
+    bool reached() {
+        maxDepth = std::max(maxDepth, depth() + 1);
+        return true;
+    }
+};
+
+int main(int argc, char* argv[]) {
+    // Non-interactive run of the library's checks, for builds and scripts
+    if (argc > 1 && std::string(argv[1]) == "--self-check") return SelfCheck::run() ? 0 : 1;
+
     std::cout << "===== DOM Parser Interactive Demo =====\n";
     std::cout << "This program demonstrates parsing and manipulating HTML/XML documents.\n\n";
 
     std::string html;
+    std::unique_ptr<Document> document;
 
     // Menu for data input method
     std::cout << "How would you like to input HTML?\n";
@@ -35,13 +75,36 @@ int main() {
     int choice = InputHandler::getNumberInput(1, 4, "Enter your choice (1-4): ");
 
     switch (choice) {
-    case 1: // From a file
-        html = InputHandler::getFileInput();
-        if (html.empty()) {
+    case 1: // From a file, mapped and parsed in place
+    {
+        std::string filename = InputHandler::getLineInput("Enter filename: ");
+        MappedFile file;
+        if (file.open(filename)) {
+            // The document keeps the mapping and borrows its text from it
+            ParseOptions options;
+            options.zeroCopy = true;
+            document = DOMParser::parseDocument(std::move(file), options);
+            break;
+        }
+
+        // Files that cannot be mapped (pipes, empty files) are parsed chunk
+        // by chunk while they are read
+        DOMParser::Session session;
+        size_t bytesRead = 0;
+        bool opened = InputHandler::readFromFileInChunks(filename, [&session, &bytesRead](std::string_view chunk) {
+            session.feed(chunk);
+            bytesRead += chunk.size();
+            });
+        if (opened && bytesRead > 0) {
+            document = session.finish();
+        }
+        else {
+            std::cout << "Could not read file or file is empty.\n";
             std::cout << "Using default HTML instead.\n";
             html = HTMLTemplates::getBasicTemplate();
         }
-        break;
+    }
+    break;
 
     case 2: // Manual input
         html = InputHandler::getMultiLineInput("Enter your HTML content:");
@@ -126,7 +189,14 @@ int main() {
 
     // Parse the HTML
     std::cout << "\nParsing HTML...\n";
-    Node* dom = DOMParser::parse(html);
+    if (!document) {
+        // html is not needed after parsing, so the document adopts it and
+        // borrows its text instead of copying every string
+        ParseOptions options;
+        options.zeroCopy = true;
+        document = DOMParser::parseDocument(std::move(html), options);
+    }
+    Node* dom = document->getRoot();
     std::cout << "Parsing complete!\n\n";
 
     // Display menu for operations
@@ -187,25 +257,9 @@ int main() {
 
         case 5: // Count elements
         {
-            std::function<void(Node*, std::map<std::string, int>&)> countNodes =
-                [&countNodes](Node* node, std::map<std::string, int>& counts) {
-                if (!node) return;
-                if (auto elementNode = dynamic_cast<ElementNode*>(node)) {
-                    counts[elementNode->getTagName()]++;
-                }
-                else if (dynamic_cast<TextNode*>(node)) {
-                    counts["#text"]++;
-                }
-                else if (dynamic_cast<CDATANode*>(node)) {
-                    counts["#cdata"]++;
-                }
-                for (const auto& child : node->getChildren()) {
-                    countNodes(child, counts);
-                }
-                };
-
-            std::map<std::string, int> counts;
-            countNodes(dom, counts);
+            NodeStats stats;
+            stats.walk(dom);
+            const std::map<std::string, int>& counts = stats.counts;
 
             std::cout << "\n=== Element Count ===\n";
             for (const auto& pair : counts) {
@@ -216,25 +270,9 @@ int main() {
 
         case 6: // DOM statistics
         {
-            std::function<void(Node*, int&, int&, int&, int&, int&)> countStats =
-                [&countStats](Node* node, int& elements, int& texts, int& cdatas, int& depth, int& currDepth) {
-                if (!node) return;
-                if (dynamic_cast<ElementNode*>(node)) elements++;
-                else if (dynamic_cast<TextNode*>(node)) texts++;
-                else if (dynamic_cast<CDATANode*>(node)) cdatas++;
-
-                currDepth++;
-                depth = std::max(depth, currDepth);
-
-                for (const auto& child : node->getChildren()) {
-                    countStats(child, elements, texts, cdatas, depth, currDepth);
-                }
-
-                currDepth--;
-                };
-
-            int elements = 0, texts = 0, cdatas = 0, maxDepth = 0, currentDepth = 0;
-            countStats(dom, elements, texts, cdatas, maxDepth, currentDepth);
+            NodeStats stats;
+            stats.walk(dom);
+            int elements = stats.elements, texts = stats.texts, cdatas = stats.cdatas, maxDepth = stats.maxDepth;
 
             std::cout << "\n=== DOM Statistics ===\n";
             std::cout << "Total Elements: " << elements << std::endl;
@@ -307,11 +345,19 @@ int main() {
         {
             std::cout << "\n=== Performance Report ===\n";
 
+            // The index is built on first use, so later reports time a lookup
             auto start = std::chrono::high_resolution_clock::now();
-            DOMUtil::buildCache(dom);
+            const ElementIndex& index = document->getIndex();
             auto end = std::chrono::high_resolution_clock::now();
-            std::chrono::duration<double, std::milli> cacheBuildTime = end - start;
-            std::cout << "Time to build index cache: " << cacheBuildTime.count() << " ms\n";
+            std::chrono::duration<double, std::milli> indexBuildTime = end - start;
+            std::cout << "Time to build element index: " << indexBuildTime.count() << " ms\n";
+
+            start = std::chrono::high_resolution_clock::now();
+            size_t indexedDivs = index.getElementsByTagName("div").size();
+            end = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double, std::milli> indexLookupTime = end - start;
+            std::cout << "Time for indexed getElementsByTagName: " << indexLookupTime.count() << " ms ("
+                << indexedDivs << " elements)\n";
 
             std::string testId = "test";
             start = std::chrono::high_resolution_clock::now();
@@ -334,17 +380,34 @@ int main() {
             std::chrono::duration<double, std::milli> querySelectorTime = end - start;
             std::cout << "Time for querySelector: " << querySelectorTime.count() << " ms\n";
 
-            size_t nodeCount = 0;
-            std::function<void(Node*)> countNodes = [&countNodes, &nodeCount](Node* node) {
-                if (!node) return;
-                nodeCount++;
-                for (const auto& child : node->getChildren()) {
-                    countNodes(child);
-                }
-                };
-            countNodes(dom);
-            size_t estimatedMemory = nodeCount * sizeof(Node);
-            std::cout << "Approximate memory usage: " << (estimatedMemory / 1024.0) << " KB\n";
+            start = std::chrono::high_resolution_clock::now();
+            MemoryUsage usage = document->memoryUsage();
+            end = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double, std::milli> memoryUsageTime = end - start;
+            std::cout << "Memory usage: " << (usage.total() / 1024.0) << " KB, measured in "
+                << memoryUsageTime.count() << " ms (" << (document->reservedBytes() / 1024.0) << " KB reserved)\n";
+            std::cout << "  Elements:          " << (usage.elementBytes / 1024.0) << " KB (" << usage.elements << ")\n";
+            std::cout << "  Text nodes:        " << (usage.textBytes / 1024.0) << " KB (" << usage.textNodes << ")\n";
+            std::cout << "  CDATA sections:    " << (usage.cdataBytes / 1024.0) << " KB (" << usage.cdataSections << ")\n";
+            std::cout << "  Tree links:        " << (usage.linkBytes / 1024.0) << " KB\n";
+            std::cout << "  Attributes:        " << (usage.attributeBytes / 1024.0) << " KB\n";
+            std::cout << "  Text content:      " << (usage.contentBytes / 1024.0) << " KB ("
+                << (usage.borrowedBytes / 1024.0) << " KB more borrowed from the source)\n";
+            std::cout << "  Listeners:         " << (usage.listenerBytes / 1024.0) << " KB\n";
+            std::cout << "  Snapshots:         " << (usage.snapshotBytes / 1024.0) << " KB\n";
+            std::cout << "  Source:            " << (usage.sourceBytes / 1024.0) << " KB\n";
+            std::cout << "  Arena slack:       " << (usage.slackBytes / 1024.0) << " KB\n";
+
+            std::cout << "\n";
+            // Streamed documents keep no source, so measure their serialized form
+            std::string_view source = document->getSource();
+            std::string sample = source.empty() ? dom->toString() : std::string(source);
+            Benchmark::scannerThroughput(sample);
+            Benchmark::indexBuild(sample);
+            Benchmark::flatTraversal(sample);
+            Benchmark::nodeDispatch(sample);
+            Benchmark::allocationCheck(sample);
+            Benchmark::serialization(sample);
         }
         break;
 
@@ -362,8 +425,8 @@ int main() {
     }
 
 
-    // Clean up
-    delete dom;
+    // Clean up: releasing the document frees the whole tree at once
+    document.reset();
     std::cout << "Memory cleaned up. Goodbye!\n";
     return 0;
 }
\ No newline at end of file
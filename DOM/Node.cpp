@@ -1,99 +1,460 @@
 #include "node.h"
 #include "event.h"
+#include "document.h"
+#include "flat_document.h"
+#include "serializer.h"
+#include "element_index.h"
 #include <iostream> // Fixed include syntax
+#include <cctype>
+#include <mutex>
+#include <new>
+#include <cstdint>
+
+// Locks guarding the first expansion of shared clones, picked by node address
+// so nodes need no lock of their own
+static const size_t MATERIALIZE_LOCKS = 64;
+static std::mutex materializeLocks[MATERIALIZE_LOCKS];
+// Held while a clone freezes its source, which writes to the source's nodes
+static std::mutex freezeMutex;
+
+static std::pmr::memory_resource* resourceFor(Document* owner) {
+    return owner ? owner->getArena() : std::pmr::get_default_resource();
+}
+
+// NodeHandle methods
+NodeHandle& NodeHandle::operator=(NodeHandle&& other) noexcept {
+    if (this != &other) {
+        NodeHandle old(release());
+        node = other.release();
+    }
+    return *this;
+}
+
+NodeHandle::~NodeHandle() {
+    // Arena nodes go with their document
+    if (node && !node->getOwnerDocument()) delete node;
+}
 
 // Base Node methods
-Node::Node() : parent(nullptr) {}
+Node::Node(NodeType type, Document* owner)
+    : parent(nullptr), firstChild(nullptr), lastChild(nullptr), previousSibling(nullptr), nextSibling(nullptr),
+    ownerDocument(owner), type(type), childrenPending(false), sharedCurrent(false), indexEpoch(0) {}
+
+Node::Node(const Node& other)
+    : parent(nullptr), firstChild(nullptr), lastChild(nullptr), previousSibling(nullptr), nextSibling(nullptr),
+    ownerDocument(nullptr), type(other.type), childrenPending(false), sharedCurrent(false), indexEpoch(0) {}
+
+std::pmr::memory_resource* Node::resource() const {
+    return resourceFor(ownerDocument);
+}
+
+ElementIndex* Node::indexHolding() const {
+    if (!ownerDocument || !ownerDocument->index.contains(this)) return nullptr;
+    return &ownerDocument->index;
+}
+
+DOMString Node::makeString(std::string_view text) const {
+    if (ownerDocument && ownerDocument->holdsSource(text)) return DOMString::borrow(text);
+    return DOMString(text, resource());
+}
 
 Node::~Node() {
-    for (auto child : children) delete child;
+    // Bottom-up through the raw links: each node is deleted once it has no
+    // children left, so deep trees need no recursion and children a shared
+    // clone never created stay uncreated
+    Node* node = firstChild;
+    while (node) {
+        if (node->firstChild) {
+            node = node->firstChild;
+            continue;
+        }
+        Node* next = node->nextSibling;
+        Node* parent = node->parent;
+        delete node;
+        if (next) {
+            node = next;
+        }
+        else if (parent != this) {
+            parent->firstChild = nullptr;
+            node = parent;
+        }
+        else {
+            node = nullptr;
+        }
+    }
+}
+
+void Node::materializeChildren() const {
+    // Only shared element clones have pending children. Readers on other
+    // threads may reach the same node; the first to take the lock creates
+    // the children and the others find them done.
+    std::lock_guard<std::mutex> lock(materializeLocks[(reinterpret_cast<uintptr_t>(this) >> 6) % MATERIALIZE_LOCKS]);
+    if (!childrenPending.load(std::memory_order_relaxed)) return;
+    Node* self = const_cast<Node*>(this);
+    const ElementNode* element = static_cast<const ElementNode*>(this);
+    const FlatDocument& snapshot = *element->snapshot;
+    for (FlatDocument::Index child = snapshot.firstChild(element->snapshotIndex); child != FlatDocument::none;
+        child = snapshot.nextSibling(child)) {
+        Node* node;
+        switch (snapshot.kind(child)) {
+        case FlatDocument::Kind::Element:
+            node = new ElementNode(element->snapshot, child);
+            break;
+        case FlatDocument::Kind::Text:
+            node = new TextNode(snapshot.content(child));
+            break;
+        default:
+            node = new CDATANode(snapshot.content(child));
+            break;
+        }
+        // Appended by hand: the subtree has not changed, only been unfolded,
+        // and each child still equals its part of the snapshot
+        node->parent = self;
+        node->sharedCurrent = true;
+        node->previousSibling = self->lastChild;
+        if (self->lastChild) self->lastChild->nextSibling = node;
+        else self->firstChild = node;
+        self->lastChild = node;
+    }
+    childrenPending.store(false, std::memory_order_release);
+}
+
+void Node::invalidateShared() {
+    for (Node* node = this; node && node->sharedCurrent.load(std::memory_order_relaxed); node = node->parent) {
+        node->sharedCurrent.store(false, std::memory_order_relaxed);
+    }
+}
+
+size_t Node::ChildList::size() const {
+    size_t count = 0;
+    for (Node* child = first; child; child = child->nextSibling) count++;
+    return count;
+}
+
+void Node::unlink() {
+    if (!parent) return;
+    if (ElementIndex* index = parent->indexHolding()) index->subtreeRemoving(this);
+    parent->invalidateShared();
+    if (previousSibling) previousSibling->nextSibling = nextSibling;
+    else parent->firstChild = nextSibling;
+    if (nextSibling) nextSibling->previousSibling = previousSibling;
+    else parent->lastChild = previousSibling;
+    parent = nullptr;
+    previousSibling = nullptr;
+    nextSibling = nullptr;
+}
+
+bool Node::canAdopt(const Node* child, const char* operation) const {
+    if (child->ownerDocument == ownerDocument) return true;
+    if (!child->ownerDocument) std::cerr << operation << ": a heap node cannot join a document's tree" << std::endl;
+    else if (!ownerDocument) std::cerr << operation << ": a document's node cannot join a heap tree" << std::endl;
+    else std::cerr << operation << ": node belongs to another document" << std::endl;
+    return false;
 }
 
 void Node::appendChild(Node* child) { // Renamed from addChild
-    children.push_back(child);
+    if (!canAdopt(child, "appendChild")) return;
+    expand();
+    invalidateShared();
+    child->unlink();
+    child->parent = this;
+    child->previousSibling = lastChild;
+    if (lastChild) lastChild->nextSibling = child;
+    else firstChild = child;
+    lastChild = child;
+    if (ElementIndex* index = indexHolding()) index->subtreeInserted(child);
+}
+
+void Node::appendChild(NodeHandle child) {
+    // On failure the handle still owns child and releases it
+    if (!canAdopt(child.get(), "appendChild")) return;
+    appendChild(child.release());
+}
+
+Node* Node::insertBefore(Node* child, Node* reference) {
+    if (!canAdopt(child, "insertBefore")) return nullptr;
+    expand();
+    if (!reference) {
+        appendChild(child);
+        return child;
+    }
+    if (reference->parent != this) {
+        std::cerr << "insertBefore: reference node is not a child of this node" << std::endl;
+        return nullptr;
+    }
+    if (child == reference) return child;
+
+    invalidateShared();
+    child->unlink();
     child->parent = this;
+    child->nextSibling = reference;
+    child->previousSibling = reference->previousSibling;
+    if (reference->previousSibling) reference->previousSibling->nextSibling = child;
+    else firstChild = child;
+    reference->previousSibling = child;
+    if (ElementIndex* index = indexHolding()) index->subtreeInserted(child);
+    return child;
 }
 
-Node* Node::getParent() const {
-    return parent;
+Node* Node::insertBefore(NodeHandle child, Node* reference) {
+    // On failure the handle still owns child and releases it
+    if (reference && reference->parent != this) return insertBefore(child.get(), reference);
+    if (!canAdopt(child.get(), "insertBefore")) return nullptr;
+    return insertBefore(child.release(), reference);
 }
 
-const std::vector<Node*>& Node::getChildren() const {
-    return children;
+NodeHandle Node::removeChild(Node* child) {
+    if (!child || child->parent != this) {
+        std::cerr << "removeChild: node is not a child of this node" << std::endl;
+        return NodeHandle();
+    }
+    child->unlink();
+    return NodeHandle(child);
 }
 
-// TextNode methods
-TextNode::TextNode(const std::string& text) : content(text) {}
+NodeHandle Node::replaceChild(Node* newChild, Node* oldChild) {
+    if (!oldChild || oldChild->parent != this) {
+        std::cerr << "replaceChild: node is not a child of this node" << std::endl;
+        return NodeHandle();
+    }
+    if (newChild == oldChild) return NodeHandle();
+    if (!canAdopt(newChild, "replaceChild")) return NodeHandle();
+
+    // newChild may be oldChild's neighbour, so take it out first
+    newChild->unlink();
+    Node* next = oldChild->nextSibling;
+    oldChild->unlink();
+    insertBefore(newChild, next);
+    return NodeHandle(oldChild);
+}
 
-std::string TextNode::getContent() const {
-    return content;
+NodeHandle Node::replaceChild(NodeHandle newChild, Node* oldChild) {
+    if (!oldChild || oldChild->parent != this) return replaceChild(newChild.get(), oldChild);
+    if (!canAdopt(newChild.get(), "replaceChild")) return NodeHandle();
+    return replaceChild(newChild.release(), oldChild);
 }
 
-void TextNode::setContent(const std::string& text) {
-    content = text;
+NodeHandle Node::detach() {
+    unlink();
+    return NodeHandle(this);
+}
+
+// TextNode methods
+TextNode::TextNode(std::string_view text, Document* owner) : Node(TYPE, owner), content(makeString(text)) {}
+
+void TextNode::setContent(std::string_view text) {
+    invalidateShared();
+    content.assign(text, resource());
 }
 
 std::string TextNode::toString() const {
-    return content;
+    return content.str();
 }
 
 Node* TextNode::clone() const {
-    return new TextNode(content);
+    return new TextNode(getContent());
 }
 
 // CDATANode methods
-CDATANode::CDATANode(const std::string& data) : content(data) {}
+CDATANode::CDATANode(std::string_view data, Document* owner) : Node(TYPE, owner), content(makeString(data)) {}
 
 std::string CDATANode::toString() const {
-    return "<![CDATA[" + content + "]]>";
+    std::string result = "<![CDATA[";
+    result += content.view();
+    result += "]]>";
+    return result;
 }
 
 Node* CDATANode::clone() const {
-    return new CDATANode(content);
+    return new CDATANode(content.view());
 }
 
 // ElementNode methods
-ElementNode::ElementNode(const std::string& tag) : tagName(tag) {}
+ElementNode::ElementNode(std::string_view tag, Document* owner)
+    : Node(TYPE, owner), tagName(AtomTable::intern(tag)), attributes(resource()), unlisted(nullptr), classes(resource()) {
+    if (tagName == Atoms::Null) setUnlistedTag(makeString(tag));
+}
 
-void ElementNode::setAttribute(const std::string& name, const std::string& value) {
-    attributes[name] = value;
+ElementNode::ElementNode(std::shared_ptr<const FlatDocument> snapshot, uint32_t index)
+    : Node(TYPE), tagName(snapshot->tag(index)), attributes(resource()), unlisted(nullptr), classes(resource()),
+    snapshotIndex(index) {
+    // Names and values stay views into the snapshot's pool until they are set
+    if (tagName == Atoms::Null) setUnlistedTag(DOMString::borrow(snapshot->tagName(index)));
+    for (size_t i = 0; i < snapshot->attributeCount(index); i++) {
+        Atom name = snapshot->attributeName(index, i);
+        DOMString value = DOMString::borrow(snapshot->attributeValue(index, i));
+        if (name != Atoms::Null) attributes.set(name, std::move(value));
+        else setUnlistedAttribute(DOMString::borrow(snapshot->attributeNameView(index, i)), std::move(value));
+    }
+    classes.assign(getAttribute(Atoms::class_));
+    childrenPending = snapshot->firstChild(index) != FlatDocument::none;
+    sharedCurrent = true;
+    this->snapshot = std::move(snapshot);
 }
 
-std::string ElementNode::getAttribute(const std::string& name) const {
-    auto it = attributes.find(name);
-    return (it != attributes.end()) ? it->second : "";
+ElementNode::~ElementNode() {
+    // Arena elements never get here; their names go with the arena
+    if (!unlisted) return;
+    unlisted->~UnlistedNames();
+    resource()->deallocate(unlisted, sizeof(UnlistedNames), alignof(UnlistedNames));
 }
 
-std::string ElementNode::getTagName() const {
-    return tagName;
+ElementNode::UnlistedNames& ElementNode::unlistedNames() {
+    if (!unlisted) {
+        void* memory = resource()->allocate(sizeof(UnlistedNames), alignof(UnlistedNames));
+        unlisted = new (memory) UnlistedNames(resource());
+    }
+    return *unlisted;
 }
 
-std::string ElementNode::toString() const {
-    std::string result = "<" + tagName;
-    for (const auto& attr : attributes) {
-        result += " " + attr.first + "=\"" + attr.second + "\"";
+void ElementNode::setUnlistedTag(DOMString&& tag) {
+    unlistedNames().tag = std::move(tag);
+}
+
+void ElementNode::setUnlistedAttribute(DOMString&& name, DOMString&& value) {
+    UnlistedAttributes& list = unlistedNames().attributes;
+    for (auto& attr : list) {
+        if (attr.name == name.view()) {
+            attr.value = std::move(value);
+            return;
+        }
     }
-    if (children.empty()) result += "/>";
-    else {
-        result += ">";
-        for (const auto& child : children) result += child->toString();
-        result += "</" + tagName + ">";
+    list.push_back({ std::move(name), std::move(value) });
+}
+
+const DOMString* ElementNode::findUnlisted(std::string_view name) const {
+    if (!unlisted) return nullptr;
+    for (const auto& attr : unlisted->attributes) {
+        if (attr.name == name) return &attr.value;
     }
-    return result;
+    return nullptr;
+}
+
+const ElementNode::UnlistedAttributes& ElementNode::getUnlistedAttributes() const {
+    static const UnlistedAttributes none;
+    return unlisted ? unlisted->attributes : none;
+}
+
+void ElementNode::setAttribute(std::string_view name, std::string_view value) {
+    invalidateShared();
+    Atom atom = AtomTable::intern(name);
+    if (atom == Atoms::Null) {
+        // Neither id nor class, so the index is not concerned
+        setUnlistedAttribute(makeString(name), makeString(value));
+        return;
+    }
+    ElementIndex* index = (atom == Atoms::id || atom == Atoms::class_) ? indexHolding() : nullptr;
+    if (index) index->attributeChanging(this, atom);
+    attributes.set(atom, makeString(value));
+    if (atom == Atoms::class_) classes.assign(value);
+    if (index) index->attributeChanged(this, atom);
+}
+
+std::string_view ElementNode::getAttribute(std::string_view name) const {
+    // A name without an atom can only be among the unlisted attributes
+    Atom atom = AtomTable::find(name);
+    if (atom != Atoms::Null) return getAttribute(atom);
+    const DOMString* value = findUnlisted(name);
+    return value ? value->view() : std::string_view();
+}
+
+std::string_view ElementNode::getAttribute(Atom name) const {
+    const DOMString* value = attributes.find(name);
+    return value ? value->view() : std::string_view();
+}
+
+bool ElementNode::hasAttribute(std::string_view name) const {
+    Atom atom = AtomTable::find(name);
+    return atom != Atoms::Null ? hasAttribute(atom) : findUnlisted(name) != nullptr;
+}
+
+bool ElementNode::hasTagName(std::string_view name) const {
+    std::string_view tag = getTagName();
+    if (tag.size() != name.size()) return false;
+    for (size_t i = 0; i < tag.size(); i++) {
+        if (tolower(static_cast<unsigned char>(tag[i])) != tolower(static_cast<unsigned char>(name[i]))) return false;
+    }
+    return true;
+}
+
+std::string ElementNode::toString() const {
+    // Markup as it was parsed: text keeps its character references
+    SerializeOptions options;
+    options.escape = false;
+    return Serializer::toString(this, options);
 }
 
 Node* ElementNode::clone() const {
-    ElementNode* copy = new ElementNode(tagName);
-    for (const auto& attr : attributes) copy->setAttribute(attr.first, attr.second);
-    for (const auto& child : children) copy->appendChild(child->clone()); // Updated to appendChild
-    return copy;
+    // A current element is part of a snapshot already; anything else is
+    // frozen first, and stays current until its subtree changes
+    if (!sharedCurrent.load(std::memory_order_acquire)) freeze();
+    return new ElementNode(snapshot, snapshotIndex);
+}
+
+void ElementNode::freeze() const {
+    std::lock_guard<std::mutex> lock(freezeMutex);
+    if (sharedCurrent.load(std::memory_order_relaxed)) return;
+    auto frozen = std::make_shared<const FlatDocument>(this);
+
+    // The snapshot numbers the subtree in pre-order. Current nodes keep the
+    // snapshot they have, since other threads may be cloning them, and so
+    // do their subtrees, which are all current too.
+    std::vector<Node*> frozenNodes;
+    Node* root = const_cast<ElementNode*>(this);
+    Node* node = root;
+    FlatDocument::Index index = 0;
+    for (;;) {
+        bool descend = false;
+        if (node->sharedCurrent.load(std::memory_order_relaxed)) {
+            index = frozen->subtreeEnd(index);
+        }
+        else {
+            if (node->type == NodeType::Element) {
+                ElementNode* element = static_cast<ElementNode*>(node);
+                // Arena elements skip their destructor; the document lets go
+                if (element->ownerDocument && !element->snapshot) element->ownerDocument->trackSnapshotHost(element);
+                element->snapshot = frozen;
+                element->snapshotIndex = index;
+            }
+            frozenNodes.push_back(node);
+            index++;
+            descend = node->getFirstChild() != nullptr;
+        }
+        if (descend) {
+            node = node->firstChild;
+            continue;
+        }
+        while (node != root && !node->nextSibling) node = node->parent;
+        if (node == root) break;
+        node = node->nextSibling;
+    }
+    // Descendants first, so a current node never has one that is not
+    for (auto it = frozenNodes.rbegin(); it != frozenNodes.rend(); ++it) {
+        (*it)->sharedCurrent.store(true, std::memory_order_release);
+    }
+}
+
+void ElementNode::addEventListener(const std::string& type, EventListener listener) {
+    // Listener storage lives on the heap, so arena-owned elements register with
+    // their document to have it released on teardown
+    if (ownerDocument && eventListeners.empty()) ownerDocument->trackListenerHost(this);
+    eventListeners[type].push_back(std::make_shared<const EventListener>(std::move(listener)));
+}
+
+const ListenerList& ElementNode::getListeners(std::string_view type) const {
+    static const ListenerList none;
+    auto it = eventListeners.find(type);
+    return (it != eventListeners.end()) ? it->second : none;
 }
 
 bool ElementNode::dispatchEvent(Event* event) {
-    std::cout << "Event '" << event->getType() << "' dispatched on element <" << tagName << ">\n";
-    auto listeners = getListeners(event->getType());
-    for (auto& listener : listeners) {
-        listener(event);
+    std::cout << "Event '" << event->getType() << "' dispatched on element <" << getTagName() << ">\n";
+    const ListenerList& listeners = getListeners(event->getType());
+    // Same snapshot rules as EventDispatcher::invokeListeners
+    size_t count = listeners.size();
+    for (size_t i = 0; i < count && i < listeners.size(); i++) {
+        std::shared_ptr<const EventListener> listener = listeners[i];
+        (*listener)(event);
     }
     return !event->isDefaultPrevented();
 }
\ No newline at end of file
@@ -6,24 +6,192 @@
 #include <functional>
 #include <vector>
 #include <map>
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <atomic>
+#include <cstdint>
+#include "dom_string.h"
+#include "atom_table.h"
+#include "attribute_map.h"
+#include "class_list.h"
 
 // Forward declarations
 class Event;
 class EventDispatcher;
+class Document;
+class FlatDocument;
+class ElementIndex;
+struct MemoryUsage;
+
+// Concrete node kinds, stored in every node so traversals can dispatch with a
+// switch (see NodeVisitor) instead of a chain of dynamic_casts
+enum class NodeType : uint8_t {
+    Element,
+    Text,
+    CDATA
+};
+
+class Node;
+
+// Owns a subtree that is not attached to any parent, as returned by
+// removeChild() and friends. Moving the handle back into a tree (appendChild,
+// insertBefore, replaceChild) re-attaches the nodes as they are, no clone
+// needed. A handle dropped while still owning heap nodes deletes them; arena
+// nodes are left for their Document to release, so the document must outlive
+// handles to its nodes.
+class NodeHandle {
+private:
+    Node* node;
+
+public:
+    NodeHandle() : node(nullptr) {}
+    explicit NodeHandle(Node* node) : node(node) {}
+    NodeHandle(NodeHandle&& other) noexcept : node(other.release()) {}
+    NodeHandle& operator=(NodeHandle&& other) noexcept;
+    NodeHandle(const NodeHandle&) = delete;
+    NodeHandle& operator=(const NodeHandle&) = delete;
+    ~NodeHandle();
+
+    Node* get() const { return node; }
+    Node* operator->() const { return node; }
+    explicit operator bool() const { return node != nullptr; }
+    // Gives up ownership without deleting anything
+    Node* release() {
+        Node* released = node;
+        node = nullptr;
+        return released;
+    }
+};
 
 // Base Node class
+//
+// Nodes created through a Document live in that document's arena: their
+// strings are allocated from it and the whole tree is released at once when
+// the Document is destroyed. Nodes created with `new` use the default heap and
+// are freed by their parent as before.
+//
+// Children form an intrusive doubly linked list through the sibling links,
+// so inserting, removing and moving a node is O(1) whatever the number of
+// siblings. Inserting a node that already has a parent moves it; a node must
+// not be inserted below itself.
+//
+// Clones share structure copy-on-write: ElementNode::clone() returns a node
+// backed by a shared, immutable FlatDocument snapshot whose children are only
+// created when they are first reached, and whose attribute values stay views
+// into the snapshot until they are set. The first clone of a parsed or
+// edited element freezes its subtree into a snapshot in O(n) and keeps it on
+// the subtree's nodes; until something in the subtree changes, further
+// clones of it, like clones of an unchanged clone, share that snapshot in
+// O(1). First access creates children under a lock, so several threads may
+// read a fresh clone at once.
+//
+// Strings that point into the source a Document keeps alive are borrowed
+// rather than copied; see DOMString.
 class Node {
+    friend class ElementNode;
+    friend class ElementIndex;
+    friend struct MemoryUsage;
 protected:
     Node* parent;
-    std::vector<Node*> children;
+    Node* firstChild;
+    Node* lastChild;
+    Node* previousSibling;
+    Node* nextSibling;
+    Document* ownerDocument;                // null for heap-allocated nodes
+    NodeType type;
+    mutable std::atomic<bool> childrenPending; // children still only in the snapshot
+    std::atomic<bool> sharedCurrent;        // subtree still equals its snapshot
+    uint32_t indexEpoch;                    // stamp of the ElementIndex holding the node
+
+    std::pmr::memory_resource* resource() const;
+    DOMString makeString(std::string_view text) const;
+    // The index of the owner document, if this node is in it
+    ElementIndex* indexHolding() const;
+
+    // Creates the children of a shared clone on first access; the acquire
+    // pairs with the release once they are linked in
+    void expand() const {
+        if (childrenPending.load(std::memory_order_acquire)) materializeChildren();
+    }
+    void materializeChildren() const;
+    // Called on every change to the subtree; clears sharedCurrent up the
+    // ancestors. A node that is not current has no current ancestors, so
+    // the walk stops at the first such node and is O(1) for ordinary trees.
+    void invalidateShared();
+
+    // Unlinks from the parent's child list; the node keeps its subtree
+    void unlink();
+    // Whether child may be linked under this node: heap nodes only under
+    // heap nodes and arena nodes only under nodes of the same document,
+    // since each tree is released the way its root was allocated. Reports
+    // a mismatch on std::cerr, naming operation.
+    bool canAdopt(const Node* child, const char* operation) const;
 
 public:
-    Node();
+    // The children of a node in document order, walked through the sibling
+    // links; cheap to copy and valid until the child list changes
+    class ChildList {
+    private:
+        Node* first;
+
+    public:
+        class iterator {
+        private:
+            Node* node;
+
+        public:
+            explicit iterator(Node* node) : node(node) {}
+            Node* operator*() const { return node; }
+            iterator& operator++() {
+                node = node->nextSibling;
+                return *this;
+            }
+            bool operator==(const iterator& other) const { return node == other.node; }
+            bool operator!=(const iterator& other) const { return node != other.node; }
+        };
+
+        explicit ChildList(Node* first) : first(first) {}
+        iterator begin() const { return iterator(first); }
+        iterator end() const { return iterator(nullptr); }
+        bool empty() const { return first == nullptr; }
+        // Counts by walking the list
+        size_t size() const;
+    };
+
+    Node(NodeType type, Document* owner = nullptr);
+    Node(const Node& other);                // copies are detached, heap-allocated and childless
+    Node& operator=(const Node&) = delete;
     virtual ~Node();
 
+    // child must have been created by this node's document, or like this
+    // node on the heap; any other child is refused (see canAdopt) and left
+    // where it was, or released with a handle that was passed in
     void appendChild(Node* child); // Renamed from addChild
-    Node* getParent() const;
-    const std::vector<Node*>& getChildren() const;
+    void appendChild(NodeHandle child);
+    // Inserts child before reference, or last when reference is null; returns
+    // child, or null if reference is not a child of this node or child is
+    // refused
+    Node* insertBefore(Node* child, Node* reference);
+    Node* insertBefore(NodeHandle child, Node* reference);
+    // Take child (or oldChild) out of this node's children and hand back
+    // ownership; an empty handle if it is not a child of this node or
+    // newChild is refused
+    NodeHandle removeChild(Node* child);
+    NodeHandle replaceChild(Node* newChild, Node* oldChild);
+    NodeHandle replaceChild(NodeHandle newChild, Node* oldChild);
+    // Removes this node from its parent, if it has one
+    NodeHandle detach();
+
+    Node* getParent() const { return parent; }
+    Node* getFirstChild() const { expand(); return firstChild; }
+    Node* getLastChild() const { expand(); return lastChild; }
+    Node* getPreviousSibling() const { return previousSibling; }
+    Node* getNextSibling() const { return nextSibling; }
+    bool hasChildNodes() const { expand(); return firstChild != nullptr; }
+    Document* getOwnerDocument() const { return ownerDocument; }
+    NodeType nodeType() const { return type; }
+    ChildList getChildren() const { expand(); return ChildList(firstChild); }
 
     virtual std::string toString() const = 0;
     virtual Node* clone() const = 0;
@@ -31,70 +199,154 @@ public:
 
 // TextNode
 class TextNode : public Node {
+    friend class FlatDocument;
+    friend struct MemoryUsage;
 private:
-    std::string content;
+    DOMString content;
 public:
-    TextNode(const std::string& text);
-    std::string getContent() const;
-    void setContent(const std::string& text);
+    static constexpr NodeType TYPE = NodeType::Text;
+
+    TextNode(std::string_view text, Document* owner = nullptr);
+    std::string_view getContent() const { return content.view(); }
+    void setContent(std::string_view text);
     std::string toString() const override;
     Node* clone() const override;
 };
 
 // CDATANode
 class CDATANode : public Node {
+    friend class FlatDocument;
+    friend struct MemoryUsage;
 private:
-    std::string content;
+    DOMString content;
 public:
-    CDATANode(const std::string& data);
+    static constexpr NodeType TYPE = NodeType::CDATA;
+
+    CDATANode(std::string_view data, Document* owner = nullptr);
+    std::string_view getContent() const { return content.view(); }
     std::string toString() const override;
     Node* clone() const override;
 };
 
 typedef std::function<void(Event*)> EventListener;
+// Listeners are shared so a dispatch can hold the one it is running without
+// copying the list, even if that listener removes or adds listeners
+typedef std::vector<std::shared_ptr<const EventListener>> ListenerList;
 
 // ElementNode
 class ElementNode : public Node {
+    friend class Node;
+    friend class Document;
+    friend class FlatDocument;
+    friend struct MemoryUsage;
+public:
+    // An attribute whose name got no atom, the AtomTable being full
+    struct UnlistedAttribute {
+        DOMString name;
+        DOMString value;
+    };
+    typedef std::pmr::vector<UnlistedAttribute> UnlistedAttributes;
+
 private:
-    std::string tagName;
-    std::map<std::string, std::string> attributes;
-    std::map<std::string, std::vector<EventListener>> eventListeners;
+    // Names past AtomTable::MAX_DYNAMIC_ATOMS, kept as strings in the
+    // element's own memory resource (its document's arena, if it has one)
+    struct UnlistedNames {
+        DOMString tag;                      // when tagName is Atoms::Null
+        UnlistedAttributes attributes;
+
+        explicit UnlistedNames(std::pmr::memory_resource* resource) : attributes(resource) {}
+    };
+
+    Atom tagName;                           // Atoms::Null for an unlisted tag
+    AttributeMap attributes;
+    UnlistedNames* unlisted;                // null while every name has an atom
+    ClassList classes;                      // the class attribute, split
+    std::map<std::string, ListenerList, std::less<>> eventListeners;
+    // Set on shared clones: the snapshot this element was created from,
+    // which also keeps its borrowed attribute values alive. Set by freeze()
+    // on cloned elements: the snapshot taken of them, reused while current.
+    mutable std::shared_ptr<const FlatDocument> snapshot;
+    mutable uint32_t snapshotIndex;
+
+    // Element snapshotIndex of snapshot, with its children left pending
+    ElementNode(std::shared_ptr<const FlatDocument> snapshot, uint32_t index);
+    // Takes a snapshot of the subtree and hands it to each node that is not
+    // current, which then is
+    void freeze() const;
+    UnlistedNames& unlistedNames();
+    void setUnlistedTag(DOMString&& tag);
+    void setUnlistedAttribute(DOMString&& name, DOMString&& value);
+    const DOMString* findUnlisted(std::string_view name) const;
 public:
-    ElementNode(const std::string& tag);
+    static constexpr NodeType TYPE = NodeType::Element;
+
+    ElementNode(std::string_view tag, Document* owner = nullptr);
+    ElementNode(const ElementNode&) = delete;
+    ~ElementNode() override;
 
-    void setAttribute(const std::string& name, const std::string& value);
-    std::string getAttribute(const std::string& name) const;
-    std::string getTagName() const;
+    // Accessors return views into the element's storage and never allocate;
+    // a view stays valid until the attribute is set again or the element is
+    // destroyed. Missing attributes read as empty.
+    void setAttribute(std::string_view name, std::string_view value);
+    std::string_view getAttribute(std::string_view name) const;
+    std::string_view getAttribute(Atom name) const;
+    bool hasAttribute(std::string_view name) const;
+    bool hasAttribute(Atom name) const { return attributes.find(name) != nullptr; }
+    const AttributeMap& getAttributes() const { return attributes; }
+    // Attributes not in getAttributes(), their names having no atom; in the
+    // order they were first set
+    const UnlistedAttributes& getUnlistedAttributes() const;
+    const ClassList& getClassList() const { return classes; }
+    bool hasClass(std::string_view name) const { return hasClass(name, ClassList::hash(name)); }
+    // With hash = ClassList::hash(name) worked out once by the caller
+    bool hasClass(std::string_view name, uint32_t hash) const {
+        return classes.contains(hash) && ClassList::names(getAttribute(Atoms::class_), name);
+    }
+    // Calls f with each class name once, in the order the names first appear
+    template <typename F>
+    void forEachClass(F f) const {
+        std::string_view classAttr = getAttribute(Atoms::class_);
+        ClassList::split(classAttr, [&](std::string_view name) {
+            if (!ClassList::names(classAttr.substr(0, name.data() - classAttr.data()), name)) f(name);
+            });
+    }
+    std::string_view getTagName() const {
+        return tagName != Atoms::Null ? AtomTable::name(tagName) : unlisted->tag.view();
+    }
+    Atom getTagAtom() const { return tagName; }
+    // Whether the tag is name, given tag = AtomTable::find(name); a name
+    // without an atom can still be the tag of an element created once the
+    // table was full
+    bool isTag(Atom tag, std::string_view name) const {
+        return tag != Atoms::Null ? tagName == tag : tagName == Atoms::Null && unlisted->tag.view() == name;
+    }
+    // ASCII case-insensitive, as HTML tag names are
+    bool hasTagName(std::string_view name) const;
 
     std::string toString() const override;
     Node* clone() const override;
+    // The snapshot the element shares with its clones, null before the first
+    // clone; elements with the same one share storage
+    const FlatDocument* getSnapshot() const { return snapshot.get(); }
 
-    void addEventListener(const std::string& type, EventListener listener) {
-        eventListeners[type].push_back(listener);
-    }
+    void addEventListener(const std::string& type, EventListener listener);
 
-    void removeEventListener(const std::string& type, EventListener listener) {
-        eventListeners[type].clear();
+    void removeEventListener(std::string_view type, EventListener listener) {
+        auto it = eventListeners.find(type);
+        if (it != eventListeners.end()) it->second.clear();
     }
 
     bool dispatchEvent(Event* event);
 
-    std::vector<EventListener> getListeners(const std::string& type) const {
-        if (eventListeners.find(type) != eventListeners.end()) {
-            return eventListeners.at(type);
-        }
-        return std::vector<EventListener>();
-    }
+    // Empty when nothing listens for type
+    const ListenerList& getListeners(std::string_view type) const;
 
     bool matchesSelector(const std::string& selector) const {
         if (selector[0] == '#') {
-            std::string id = selector.substr(1);
-            return getAttribute("id") == id;
+            return getAttribute(Atoms::id) == std::string_view(selector).substr(1);
         }
         else if (selector[0] == '.') {
-            std::string className = selector.substr(1);
-            std::string classAttr = getAttribute("class");
-            return classAttr.find(className) != std::string::npos;
+            return hasClass(std::string_view(selector).substr(1));
         }
         else {
             return getTagName() == selector;
@@ -102,4 +354,16 @@ public:
     }
 };
 
+// Checked downcast on the stored node type, the cheap replacement for
+// dynamic_cast<T*>(node); null when node is null or of another kind
+template <typename T>
+T* nodeCast(Node* node) {
+    return (node && node->nodeType() == T::TYPE) ? static_cast<T*>(node) : nullptr;
+}
+
+template <typename T>
+const T* nodeCast(const Node* node) {
+    return (node && node->nodeType() == T::TYPE) ? static_cast<const T*>(node) : nullptr;
+}
+
 #endif // NODE_H
\ No newline at end of file
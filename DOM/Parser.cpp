@@ -1,42 +1,62 @@
 #include "parser.h"
+#include "tree_builder.h"
+#include "event_log.h"
+#include "worker_pool.h"
 #include <cctype>
 #include <algorithm>
+#include <cstring>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
-std::string DOMParser::trim(const std::string& str) {
+// Inputs are split for parallel tokenizing into chunks of about this size
+static const size_t PARALLEL_CHUNK_SIZE = 1024 * 1024;
+// How many chunks each worker may tokenize ahead of the replay
+static const size_t PARALLEL_CHUNKS_AHEAD = 2;
+
+std::string_view DOMParser::trim(std::string_view str) {
     size_t first = str.find_first_not_of(" \t\n\r");
-    if (first == std::string::npos) return "";
+    if (first == std::string_view::npos) return std::string_view();
     size_t last = str.find_last_not_of(" \t\n\r");
     return str.substr(first, last - first + 1);
 }
 
-std::pair<std::string, std::map<std::string, std::string>> DOMParser::parseTag(const std::string& tag) {
-    std::string tagName;
-    std::map<std::string, std::string> attributes;
+std::string_view DOMParser::parseTag(std::string_view html, size_t begin, size_t end,
+    StructuralIndex& index, AttributeList& attributes) {
+    attributes.clear();
+    std::string_view tag = html.substr(begin, end - begin);
     size_t spacePos = tag.find(' ');
-    if (spacePos == std::string::npos) tagName = tag;
-    else {
-        tagName = tag.substr(0, spacePos);
-        std::string attrStr = tag.substr(spacePos + 1);
-        size_t pos = 0;
-        while (pos < attrStr.length()) {
-            while (pos < attrStr.length() && isspace(attrStr[pos])) pos++;
-            if (pos >= attrStr.length()) break;
-            size_t eqPos = attrStr.find('=', pos);
-            if (eqPos == std::string::npos) break;
-            std::string name = trim(attrStr.substr(pos, eqPos - pos));
-            pos = eqPos + 1;
-            while (pos < attrStr.length() && isspace(attrStr[pos])) pos++;
-            if (pos < attrStr.length() && attrStr[pos] == '"') {
-                pos++;
-                size_t closeQuote = attrStr.find('"', pos);
-                if (closeQuote == std::string::npos) break;
-                std::string value = attrStr.substr(pos, closeQuote - pos);
-                attributes[name] = value;
-                pos = closeQuote + 1;
-            }
+    if (spacePos == std::string_view::npos) return tag;
+
+    size_t pos = begin + spacePos + 1;
+    while (pos < end) {
+        while (pos < end && isspace(static_cast<unsigned char>(html[pos]))) pos++;
+        if (pos >= end) break;
+        size_t eqPos = index.find('=', pos, end);
+        if (eqPos == StructuralIndex::npos) break;
+        std::string_view name = trim(html.substr(pos, eqPos - pos));
+        pos = eqPos + 1;
+        while (pos < end && isspace(static_cast<unsigned char>(html[pos]))) pos++;
+        if (pos < end && html[pos] == '"') {
+            pos++;
+            size_t closeQuote = index.find('"', pos, end);
+            if (closeQuote == StructuralIndex::npos) break;
+            attributes.emplace_back(name, html.substr(pos, closeQuote - pos));
+            pos = closeQuote + 1;
         }
     }
-    return std::make_pair(tagName, attributes);
+    return tag.substr(0, spacePos);
+}
+
+// Finds a three-character terminator ending in '>' ("-->" or "]]>") that
+// starts at or after from; returns the position of its '>'
+static size_t findTerminator(std::string_view html, StructuralIndex& index, size_t from, const char* terminator) {
+    size_t closeBracket = index.find('>', from + 2);
+    while (closeBracket != StructuralIndex::npos) {
+        if (html[closeBracket - 2] == terminator[0] && html[closeBracket - 1] == terminator[1]) return closeBracket;
+        closeBracket = index.find('>', closeBracket + 1);
+    }
+    return StructuralIndex::npos;
 }
 
 Node* DOMParser::parse(const std::string& html) {
@@ -46,82 +66,329 @@ Node* DOMParser::parse(const std::string& html) {
     return root;
 }
 
-void DOMParser::parseElement(const std::string& html, size_t& pos, Node* parent) {
-    while (pos < html.length()) {
-        size_t openBracket = html.find('<', pos);
+void DOMParser::parse(std::string_view html, ParseHandler& handler, const ParseOptions& options) {
+    size_t pos = 0;
+    tokenize(html, pos, handler, options);
+}
+
+std::unique_ptr<Document> DOMParser::parseDocument(const std::string& html, const ParseOptions& options) {
+    return parseDocument(html.data(), html.length(), options);
+}
+
+std::unique_ptr<Document> DOMParser::parseDocument(const char* data, size_t length, const ParseOptions& options) {
+    if (options.zeroCopy) return parseDocument(std::string(data, length), options);
+
+    // Parsed trees take roughly twice the source size once node headers are added
+    auto document = std::make_unique<Document>(std::max<size_t>(length * 2, 4096));
+    size_t pos = 0;
+    parseElement(std::string_view(data, length), pos, document->getRoot(), options);
+    return document;
+}
+
+std::unique_ptr<Document> DOMParser::parseDocument(std::string&& html, const ParseOptions& options) {
+    if (!options.zeroCopy) return parseDocument(static_cast<const std::string&>(html), options);
+
+    // Borrowed strings take no arena space, so only node headers need room
+    auto document = std::make_unique<Document>(std::max<size_t>(html.length(), 4096));
+    std::string_view source = document->adoptSource(std::move(html));
+    size_t pos = 0;
+    parseElement(source, pos, document->getRoot(), options);
+    return document;
+}
+
+std::unique_ptr<Document> DOMParser::parseDocument(MappedFile&& file, const ParseOptions& options) {
+    if (!options.zeroCopy) return parseDocument(file.getData(), file.size(), options);
+
+    auto document = std::make_unique<Document>(std::max<size_t>(file.size(), 4096));
+    std::string_view source = document->adoptSource(std::move(file));
+    size_t pos = 0;
+    parseElement(source, pos, document->getRoot(), options);
+    return document;
+}
+
+void DOMParser::parseElement(std::string_view html, size_t& pos, Node* parent, const ParseOptions& options) {
+    TreeBuilder builder(parent, options.maxDepth, options.buildIndex);
+    tokenize(html, pos, builder, options);
+}
+
+void DOMParser::tokenize(std::string_view html, size_t& pos, ParseHandler& handler, const ParseOptions& options) {
+    unsigned threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    if (threads > 1 && html.length() - pos >= 2 * PARALLEL_CHUNK_SIZE) {
+        tokenizeParallel(html, pos, handler, threads, options.stats);
+        return;
+    }
+    StructuralIndex index(html);
+    tokenize(html, index, pos, handler, true);
+}
+
+// Next '<' at or after from that is followed by a tag name or '/', the
+// likeliest place for a token to start; npos if there is none
+static size_t findSplit(std::string_view html, size_t from) {
+    size_t split = html.find('<', from);
+    while (split != std::string_view::npos && split + 1 < html.length()) {
+        char next = html[split + 1];
+        if (isalpha(static_cast<unsigned char>(next)) || next == '/') return split;
+        split = html.find('<', split + 1);
+    }
+    return std::string_view::npos;
+}
+
+// Speculative parallel tokenization. The input is cut into chunks at likely
+// tag starts and WorkerPool threads tokenize chunks into event logs, which
+// this thread replays into handler in order. A chunk's log is only used if
+// the previous chunk's last token ended exactly where the chunk begins; when
+// a cut landed inside a token instead (a comment or CDATA section, or a '<'
+// within a tag), that chunk is tokenized again serially from where the
+// previous token really ended. A chunk no worker has taken by the time the
+// replay reaches it is tokenized on this thread, so the parse completes
+// whether or not the pool has threads free. Workers stay a bounded number
+// of chunks ahead of the replay, so logs never hold more than a few chunks.
+// Only tokenizing is parallel; handler, and so tree construction, sees
+// every event on this thread.
+void DOMParser::tokenizeParallel(std::string_view html, size_t& pos, ParseHandler& handler, unsigned threads, ParseStats* stats) {
+    std::vector<size_t> starts;
+    size_t from = pos;
+    while (true) {
+        starts.push_back(from);
+        if (html.length() - from < 2 * PARALLEL_CHUNK_SIZE) break;
+        size_t split = findSplit(html, from + PARALLEL_CHUNK_SIZE);
+        if (split == std::string_view::npos) break;
+        from = split;
+    }
+    size_t chunks = starts.size();
+    starts.push_back(html.length());
+    ParseStats counts;
+    counts.chunks = chunks - 1;
+
+    struct Chunk {
+        EventLog log;
+        size_t end = 0;         // where tokenizing the chunk stopped
+        bool ready = false;
+    };
+    std::vector<Chunk> results(chunks);
+    std::mutex mutex;
+    std::condition_variable changed;
+    size_t nextChunk = 1;       // chunk 0 is tokenized straight into handler
+    size_t replayed = 0;
+    bool stopping = false;
+
+    size_t workers = std::min<size_t>(threads - 1, chunks - 1);
+    size_t ahead = workers * PARALLEL_CHUNKS_AHEAD;
+    auto work = [&](unsigned) {
+        StructuralIndex index(html);
+        while (true) {
+            size_t i;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&] { return stopping || nextChunk >= chunks || nextChunk <= replayed + ahead; });
+                if (stopping || nextChunk >= chunks) return;
+                i = nextChunk++;
+            }
+            size_t end = starts[i];
+            tokenize(html, index, end, results[i].log, true, starts[i + 1]);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                results[i].end = end;
+                results[i].ready = true;
+            }
+            changed.notify_all();
+        }
+    };
+
+    // Stops the workers and waits for them however this function is left,
+    // since they refer to its locals
+    struct Stop {
+        WorkerPool::Batch batch;
+        std::mutex& mutex;
+        std::condition_variable& changed;
+        bool& stopping;
+
+        ~Stop() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            changed.notify_all();
+            WorkerPool::shared().finish(batch);
+        }
+    } stop{ {}, mutex, changed, stopping };
+    WorkerPool::shared().start(stop.batch, static_cast<unsigned>(workers), work);
+
+    StructuralIndex index(html);
+    size_t end = pos;
+    tokenize(html, index, end, handler, true, starts[1]);
+    for (size_t i = 1; i < chunks && !handler.done(); i++) {
+        bool taken;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            taken = nextChunk > i;
+            if (taken) changed.wait(lock, [&] { return results[i].ready; });
+            else nextChunk = i + 1;
+        }
+        if (taken && end == starts[i]) {
+            results[i].log.replay(handler);
+            end = results[i].end;
+            counts.replayed++;
+        }
+        else {
+            tokenize(html, index, end, handler, true, starts[i + 1]);
+            counts.retokenized++;
+        }
+        results[i].log.clear();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            replayed = i;
+        }
+        changed.notify_all();
+    }
+
+    pos = end;
+    if (stats) *stats = counts;
+}
+
+void DOMParser::tokenize(std::string_view html, StructuralIndex& index, size_t& pos,
+    ParseHandler& handler, bool final, size_t stop) {
+    AttributeList attributes;
+    while (pos < html.length() && pos < stop && !handler.done()) {
+        size_t openBracket = index.find('<', pos);
 
         if (openBracket > pos) {
-            std::string text = html.substr(pos, openBracket - pos);
+            // Without a following '<' the text may continue in the next chunk
+            if (openBracket == StructuralIndex::npos && !final) return;
+            std::string_view text = html.substr(pos, openBracket - pos);
+            pos = std::min(openBracket, html.length());
             if (!trim(text).empty()) {
-                parent->appendChild(new TextNode(text));
+                handler.text(text);
+                if (handler.done()) return;
             }
-            pos = openBracket;
+            // The next token starts at openBracket, which may be past stop
+            if (pos >= stop) break;
         }
 
-        if (openBracket == std::string::npos) {
+        if (openBracket == StructuralIndex::npos) {
             pos = html.length();
             break;
         }
 
         if (html.compare(openBracket, 4, "<!--") == 0) {
-            size_t endComment = html.find("-->", openBracket);
-            if (endComment == std::string::npos) {
+            size_t endComment = findTerminator(html, index, openBracket, "-->");
+            if (endComment == StructuralIndex::npos) {
+                if (!final) return;
                 pos = html.length();
+                handler.comment(html.substr(openBracket + 4));
             }
             else {
-                pos = endComment + 3;
+                pos = endComment + 1;
+                // "<!-->" ends right after its opener
+                size_t contentEnd = std::max(endComment - 2, openBracket + 4);
+                handler.comment(html.substr(openBracket + 4, contentEnd - openBracket - 4));
             }
             continue;
         }
 
         if (html.compare(openBracket, 9, "<![CDATA[") == 0) {
-            size_t end = html.find("]]>", openBracket);
-            if (end != std::string::npos) {
-                std::string data = html.substr(openBracket + 9, end - openBracket - 9);
-                parent->appendChild(new CDATANode(data));
-                pos = end + 3;
+            size_t end = findTerminator(html, index, openBracket, "]]>");
+            if (end != StructuralIndex::npos) {
+                pos = end + 1;
+                handler.cdata(html.substr(openBracket + 9, end - 2 - openBracket - 9));
                 continue;
             }
+            if (!final) return;
         }
 
         if (html.compare(openBracket, 2, "<!") == 0) {
-            size_t closeBracket = html.find('>', openBracket);
-            pos = (closeBracket == std::string::npos) ? html.length() : closeBracket + 1;
+            size_t closeBracket = index.find('>', openBracket);
+            if (closeBracket == StructuralIndex::npos && !final) return;
+            pos = (closeBracket == StructuralIndex::npos) ? html.length() : closeBracket + 1;
             continue;
         }
 
-        if (html[openBracket + 1] == '/') {
-            size_t closeBracket = html.find('>', openBracket);
-            pos = (closeBracket == std::string::npos) ? html.length() : closeBracket + 1;
-            return;
+        // The byte after '<' decides what kind of token this is
+        if (openBracket + 1 >= html.length() && !final) return;
+
+        if (openBracket + 1 < html.length() && html[openBracket + 1] == '/') {
+            size_t closeBracket = index.find('>', openBracket);
+            if (closeBracket == StructuralIndex::npos && !final) return;
+            size_t nameEnd = (closeBracket == StructuralIndex::npos) ? html.length() : closeBracket;
+            pos = (closeBracket == StructuralIndex::npos) ? html.length() : closeBracket + 1;
+            handler.endElement(trim(html.substr(openBracket + 2, nameEnd - openBracket - 2)));
+            continue;
         }
 
-        size_t closeBracket = html.find('>', openBracket);
-        if (closeBracket == std::string::npos) {
+        size_t closeBracket = index.find('>', openBracket);
+        if (closeBracket == StructuralIndex::npos) {
+            if (!final) return;
             pos = html.length();
             break;
         }
 
-        std::string tagContent = html.substr(openBracket + 1, closeBracket - openBracket - 1);
+        size_t tagEnd = closeBracket;
         bool selfClosing = false;
-        if (!tagContent.empty() && tagContent.back() == '/') {
+        if (tagEnd > openBracket + 1 && html[tagEnd - 1] == '/') {
             selfClosing = true;
-            tagContent.pop_back();
+            tagEnd--;
         }
 
-        auto parsedTag = parseTag(tagContent);
-        std::string tagName = parsedTag.first;
-        const auto& attributes = parsedTag.second;
-
-        ElementNode* elementNode = new ElementNode(tagName);
-        for (const auto& attr : attributes) {
-            elementNode->setAttribute(attr.first, attr.second);
-        }
-        parent->appendChild(elementNode);
+        std::string_view tagName = parseTag(html, openBracket + 1, tagEnd, index, attributes);
         pos = closeBracket + 1;
 
-        if (!selfClosing) {
-            parseElement(html, pos, elementNode);
+        handler.startElement(tagName, attributes);
+        if (selfClosing && !handler.done()) {
+            handler.endElement(tagName);
         }
     }
+}
+
+// Session methods
+DOMParser::Session::Session(size_t sizeHint, const ParseOptions& options)
+    : document(std::make_unique<Document>(sizeHint)), handler(nullptr), scanned(0), index(std::string_view()), finished(false) {
+    builder = std::make_unique<TreeBuilder>(document->getRoot(), options.maxDepth, options.buildIndex);
+    handler = builder.get();
+}
+
+DOMParser::Session::Session(ParseHandler& handler)
+    : handler(&handler), scanned(0), index(std::string_view()), finished(false) {}
+
+DOMParser::Session::~Session() = default;
+
+const char* DOMParser::Session::awaitedTerminator() const {
+    if (pending[0] != '<') return "<";
+    if (pending.compare(0, 4, "<!--") == 0) return "-->";
+    if (pending.compare(0, 9, "<![CDATA[") == 0) return "]]>";
+    return ">";
+}
+
+void DOMParser::Session::feed(std::string_view chunk) {
+    if (finished || handler->done()) return;
+
+    // A cut-off token can only complete once its terminator arrives, so skip
+    // re-tokenizing the pending tail until then. Only the new bytes, and the
+    // end of the old ones a terminator may straddle, are searched; a long
+    // comment or CDATA section with '>' inside is not rescanned per chunk.
+    const char* terminator = pending.empty() ? nullptr : awaitedTerminator();
+    pending.append(chunk.data(), chunk.size());
+    if (terminator) {
+        size_t overlap = std::strlen(terminator) - 1;
+        size_t from = (scanned > overlap) ? scanned - overlap : 0;
+        scanned = pending.size();
+        if (pending.find(terminator, from) == std::string::npos) return;
+    }
+    run(false);
+}
+
+std::unique_ptr<Document> DOMParser::Session::finish() {
+    if (!finished && !handler->done()) run(true);
+    finished = true;
+    pending.clear();
+    pending.shrink_to_fit();
+    return std::move(document);
+}
+
+void DOMParser::Session::run(bool final) {
+    index.reset(pending);
+    size_t pos = 0;
+    tokenize(pending, index, pos, *handler, final);
+    pending.erase(0, pos);
+    // The tokenizer stopped at a token whose terminator is not in pending
+    scanned = pending.size();
 }
\ No newline at end of file
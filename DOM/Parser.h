@@ -3,18 +3,110 @@
 #define PARSER_H
 
 #include "node.h"
+#include "document.h"
+#include "structural_index.h"
+#include "parse_handler.h"
 #include <string>
-#include <map>
+#include <string_view>
+#include <vector>
+#include <memory>
 #include <utility>
 
+class TreeBuilder;
+
+// How a parallel parse used the chunks its workers tokenized
+struct ParseStats {
+    size_t chunks = 0;          // after the first, which is never speculative
+    size_t replayed = 0;        // chunks whose worker log was replayed
+    size_t retokenized = 0;     // chunks tokenized on the calling thread instead
+};
+
+struct ParseOptions {
+    // Keep the source alive in the Document and borrow text and attribute
+    // values from it; strings are only copied when mutated
+    bool zeroCopy = false;
+    // Deepest nesting the built tree may reach below its root; elements
+    // opened deeper are appended to the element at this depth instead, as
+    // browsers do, so recursive tree walks (Node::toString) stay bounded.
+    // This changes the shape of such documents, so the first flattened
+    // element is reported on std::cerr. 0 disables the guard.
+    size_t maxDepth = 512;
+    // Worker threads for tokenizing large inputs (several MB) in parallel;
+    // 0 uses every hardware thread. Events still reach the tree builder or
+    // handler in document order, on the calling thread.
+    unsigned threads = 1;
+    // Fill the document's ElementIndex as elements are created, so it is
+    // ready when parsing returns instead of built on first use
+    bool buildIndex = false;
+    // Filled in by a parallel parse when set
+    ParseStats* stats = nullptr;
+};
+
 class DOMParser {
 private:
-    static std::string trim(const std::string& str);
-    static std::pair<std::string, std::map<std::string, std::string>> parseTag(const std::string& tag);
+    static std::string_view trim(std::string_view str);
+    // Parses the tag body html[begin, end); returns the tag name and fills
+    // attributes with views into html
+    static std::string_view parseTag(std::string_view html, size_t begin, size_t end,
+        StructuralIndex& index, AttributeList& attributes);
+    // Tokenizes html from pos and reports every token to handler, stopping
+    // before the first token that starts at or after stop. Unless final is
+    // set it also stops at the start of a token cut off by the end of html,
+    // leaving pos there. Stops early once handler.done() returns true.
+    static void tokenize(std::string_view html, StructuralIndex& index, size_t& pos,
+        ParseHandler& handler, bool final, size_t stop = StructuralIndex::npos);
+    // Tokenizes all of html from pos, in parallel when options ask for
+    // threads and the input is large enough to split
+    static void tokenize(std::string_view html, size_t& pos, ParseHandler& handler, const ParseOptions& options);
+    static void tokenizeParallel(std::string_view html, size_t& pos, ParseHandler& handler, unsigned threads, ParseStats* stats);
 
 public:
+    // Incremental parsing of a document that arrives in chunks. Tokens cut
+    // off at a chunk boundary (mid-tag, mid-comment, mid-CDATA or mid-text)
+    // are kept back and resumed when the next chunk arrives; only that
+    // unconsumed tail is buffered, never the whole input.
+    //
+    // A session either builds a Document or, constructed with a handler,
+    // only streams events to it so that memory stays bounded by the longest
+    // token rather than by the document.
+    class Session {
+    private:
+        std::unique_ptr<Document> document;
+        std::unique_ptr<TreeBuilder> builder;
+        ParseHandler* handler;
+        std::string pending;        // start of a token not complete yet
+        size_t scanned;             // bytes of pending known not to complete it
+        StructuralIndex index;
+        bool finished;
+
+        // What the token at the start of pending ends with
+        const char* awaitedTerminator() const;
+        void run(bool final);
+
+    public:
+        explicit Session(size_t sizeHint = 64 * 1024, const ParseOptions& options = ParseOptions());
+        explicit Session(ParseHandler& handler);
+        ~Session();
+
+        void feed(std::string_view chunk);
+        // Parses whatever is still pending and hands over the document
+        // (null for a handler session)
+        std::unique_ptr<Document> finish();
+    };
+
     static Node* parse(const std::string& html);
-    static void parseElement(const std::string& html, size_t& pos, Node* parent);
+    // Streams the tokens of html to handler without building a tree
+    static void parse(std::string_view html, ParseHandler& handler, const ParseOptions& options = ParseOptions());
+    // Parses into an arena-backed Document; the whole tree is freed with the handle
+    static std::unique_ptr<Document> parseDocument(const std::string& html, const ParseOptions& options = ParseOptions());
+    // Parses straight from a caller-owned buffer; only a zero-copy document
+    // copies it, once, to keep the text its nodes borrow
+    static std::unique_ptr<Document> parseDocument(const char* data, size_t length, const ParseOptions& options = ParseOptions());
+    // Same, but a zero-copy document adopts html instead of copying it
+    static std::unique_ptr<Document> parseDocument(std::string&& html, const ParseOptions& options = ParseOptions());
+    // A zero-copy document adopts the mapping, so nothing is ever copied
+    static std::unique_ptr<Document> parseDocument(MappedFile&& file, const ParseOptions& options = ParseOptions());
+    static void parseElement(std::string_view html, size_t& pos, Node* parent, const ParseOptions& options = ParseOptions());
 };
 
 #endif // PARSER_H
\ No newline at end of file
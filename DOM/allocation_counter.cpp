@@ -0,0 +1,44 @@
+#include "allocation_counter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef DOM_COUNT_ALLOCATIONS
+static std::atomic<size_t> allocationCount(0);
+
+// Every plain operator new in the program goes through here
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (size == 0) size = 1;
+    for (;;) {
+        if (void* memory = std::malloc(size)) return memory;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+bool AllocationCounter::enabled() {
+    return true;
+}
+
+size_t AllocationCounter::count() {
+    return allocationCount.load(std::memory_order_relaxed);
+}
+#else
+bool AllocationCounter::enabled() {
+    return false;
+}
+
+size_t AllocationCounter::count() {
+    return 0;
+}
+#endif
\ No newline at end of file
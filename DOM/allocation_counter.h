@@ -0,0 +1,28 @@
+#pragma once
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <cstddef>
+
+// Counts heap allocations, so that the benchmark and the self-checks can show
+// that read paths make none. Only builds with DOM_COUNT_ALLOCATIONS defined
+// (the CountAllocations configuration) replace the global operator new to
+// count; the shared counter costs every allocation an atomic increment and
+// would skew the multi-threaded benchmarks. Other builds keep the standard
+// allocator and count nothing.
+class AllocationCounter {
+public:
+    static bool enabled();
+    // Plain operator new calls made so far; always 0 unless enabled()
+    static size_t count();
+
+    // Allocations made while fn runs
+    template <typename Fn>
+    static size_t during(Fn fn) {
+        size_t before = count();
+        fn();
+        return count() - before;
+    }
+};
+
+#endif // ALLOCATION_COUNTER_H
\ No newline at end of file
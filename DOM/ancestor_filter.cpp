@@ -0,0 +1,71 @@
+#include "ancestor_filter.h"
+#include "node.h"
+#include <cstring>
+
+static const uint32_t TAG_SALT = 0x2545F491u;
+static const uint32_t ID_SALT = 0x9E3779B9u;
+static const uint32_t CLASS_SALT = 0x6A09E667u;
+
+// Final mix of MurmurHash3, so that neighbouring atoms land far apart
+static uint32_t mix(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
+uint32_t AncestorFilter::tagHash(Atom tag) {
+    return mix(tag ^ TAG_SALT);
+}
+
+uint32_t AncestorFilter::idHash(std::string_view id) {
+    // FNV-1a; ids are not interned
+    uint32_t h = 2166136261u;
+    for (char c : id) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 16777619u;
+    }
+    return mix(h ^ ID_SALT);
+}
+
+uint32_t AncestorFilter::classHash(uint32_t className) {
+    return mix(className ^ CLASS_SALT);
+}
+
+AncestorFilter::AncestorFilter() {
+    std::memset(counters, 0, sizeof(counters));
+}
+
+void AncestorFilter::add(uint32_t hash) {
+    uint8_t& first = counters[hash % COUNTERS];
+    uint8_t& second = counters[(hash >> 12) % COUNTERS];
+    if (first != UINT8_MAX) first++;
+    if (second != UINT8_MAX) second++;
+}
+
+void AncestorFilter::remove(uint32_t hash) {
+    uint8_t& first = counters[hash % COUNTERS];
+    uint8_t& second = counters[(hash >> 12) % COUNTERS];
+    if (first != UINT8_MAX) first--;
+    if (second != UINT8_MAX) second--;
+}
+
+void AncestorFilter::push(const ElementNode* element) {
+    hashes.push_back(tagHash(element->getTagAtom()));
+    std::string_view id = element->getAttribute(Atoms::id);
+    if (!id.empty()) hashes.push_back(idHash(id));
+    for (uint32_t className : element->getClassList()) hashes.push_back(classHash(className));
+
+    size_t begin = ends.empty() ? 0 : ends.back();
+    for (size_t i = begin; i < hashes.size(); i++) add(hashes[i]);
+    ends.push_back(hashes.size());
+}
+
+void AncestorFilter::pop() {
+    ends.pop_back();
+    size_t begin = ends.empty() ? 0 : ends.back();
+    for (size_t i = begin; i < hashes.size(); i++) remove(hashes[i]);
+    hashes.resize(begin);
+}
\ No newline at end of file
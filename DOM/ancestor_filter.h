@@ -0,0 +1,65 @@
+#pragma once
+#ifndef ANCESTOR_FILTER_H
+#define ANCESTOR_FILTER_H
+
+#include "atom_table.h"
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+class ElementNode;
+
+// A counting Bloom filter over the tag, id and class names of a set of
+// elements: during a selector walk, the ancestors of the element being
+// matched.
+//
+// An element can only match "nav .item" or "ul > li" if its ancestors carry
+// every tag, id and class the compounds left of the last combinator name.
+// When one of those names is missing from the filter the element is
+// rejected without a single step up the tree; only when all of them may be
+// present are the ancestors actually walked. A walk pushes each element
+// before moving into its children and pops it once past its last
+// descendant. The filter keeps the hashes of the elements pushed, so a pop
+// is a few decrements and never looks at the element again.
+//
+// Each name bumps two one-byte counters picked by the low and high halves of
+// a 24-bit hash. A counter that reaches its maximum is never decremented
+// again, which can only add false positives.
+class AncestorFilter {
+public:
+    static const size_t COUNTERS = 4096;
+
+private:
+    uint8_t counters[COUNTERS];
+    std::vector<uint32_t> hashes;       // of every element pushed, in order
+    std::vector<size_t> ends;           // one past each element's last hash
+
+    void add(uint32_t hash);
+    void remove(uint32_t hash);
+
+public:
+    // Hashes of an element's names, salted by kind so that a tag and a class
+    // spelled alike do not share counters
+    static uint32_t tagHash(Atom tag);
+    static uint32_t idHash(std::string_view id);
+    // From ClassList::hash of the class name
+    static uint32_t classHash(uint32_t className);
+
+    AncestorFilter();
+    AncestorFilter(const AncestorFilter&) = delete;
+    AncestorFilter& operator=(const AncestorFilter&) = delete;
+
+    void push(const ElementNode* element);
+    // Takes out the element pushed last
+    void pop();
+    // Elements pushed and not popped
+    size_t size() const { return ends.size(); }
+
+    // False if no pushed element has the name behind hash
+    bool mayContain(uint32_t hash) const {
+        return counters[hash % COUNTERS] && counters[(hash >> 12) % COUNTERS];
+    }
+};
+
+#endif // ANCESTOR_FILTER_H
\ No newline at end of file
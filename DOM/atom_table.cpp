@@ -0,0 +1,97 @@
+#include "atom_table.h"
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+static constexpr std::string_view predefinedNames[] = {
+#define DOM_ATOM_NAME(identifier, name) name,
+    DOM_PREDEFINED_ATOMS(DOM_ATOM_NAME)
+#undef DOM_ATOM_NAME
+};
+
+static constexpr size_t PREDEFINED_NAMES = sizeof(predefinedNames) / sizeof(predefinedNames[0]);
+
+static constexpr bool predefinedNamesSorted() {
+    for (size_t i = 1; i < PREDEFINED_NAMES; i++) {
+        if (!(predefinedNames[i - 1] < predefinedNames[i])) return false;
+    }
+    return true;
+}
+
+static_assert(PREDEFINED_NAMES + 1 == Atoms::PredefinedCount, "Atom enum and name table are out of sync");
+static_assert(predefinedNamesSorted(), "DOM_PREDEFINED_ATOMS must stay sorted and unique for binary search");
+
+// Names interned at run time; readers share the lock, new names take it exclusively
+struct DynamicAtoms {
+    std::shared_mutex mutex;
+    std::deque<std::string> storage;        // stable addresses for the views below
+    std::vector<std::string_view> names;    // indexed by atom - PredefinedCount
+    std::unordered_map<std::string_view, Atom> atoms;
+};
+
+static DynamicAtoms& dynamicAtoms() {
+    static DynamicAtoms table;
+    return table;
+}
+
+static Atom findPredefined(std::string_view name) {
+    const std::string_view* end = predefinedNames + PREDEFINED_NAMES;
+    const std::string_view* it = std::lower_bound(predefinedNames, end, name);
+    return (it != end && *it == name) ? static_cast<Atom>(it - predefinedNames) + 1 : Atoms::Null;
+}
+
+Atom AtomTable::intern(std::string_view name) {
+    Atom atom = findPredefined(name);
+    if (atom != Atoms::Null) return atom;
+
+    DynamicAtoms& table = dynamicAtoms();
+    {
+        std::shared_lock<std::shared_mutex> lock(table.mutex);
+        auto it = table.atoms.find(name);
+        if (it != table.atoms.end()) return it->second;
+        // A full table never takes the exclusive lock again
+        if (table.names.size() >= MAX_DYNAMIC_ATOMS) return Atoms::Null;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(table.mutex);
+    // Another thread may have added it between the two locks
+    auto it = table.atoms.find(name);
+    if (it != table.atoms.end()) return it->second;
+    if (table.names.size() >= MAX_DYNAMIC_ATOMS) return Atoms::Null;
+
+    std::string_view stored = table.storage.emplace_back(name);
+    atom = static_cast<Atom>(Atoms::PredefinedCount + table.names.size());
+    table.names.push_back(stored);
+    table.atoms.emplace(stored, atom);
+    return atom;
+}
+
+Atom AtomTable::find(std::string_view name) {
+    Atom atom = findPredefined(name);
+    if (atom != Atoms::Null) return atom;
+
+    DynamicAtoms& table = dynamicAtoms();
+    std::shared_lock<std::shared_mutex> lock(table.mutex);
+    auto it = table.atoms.find(name);
+    return (it != table.atoms.end()) ? it->second : Atoms::Null;
+}
+
+std::string_view AtomTable::name(Atom atom) {
+    if (atom == Atoms::Null) return std::string_view();
+    if (atom < Atoms::PredefinedCount) return predefinedNames[atom - 1];
+
+    DynamicAtoms& table = dynamicAtoms();
+    std::shared_lock<std::shared_mutex> lock(table.mutex);
+    size_t index = atom - Atoms::PredefinedCount;
+    return (index < table.names.size()) ? table.names[index] : std::string_view();
+}
+
+size_t AtomTable::size() {
+    DynamicAtoms& table = dynamicAtoms();
+    std::shared_lock<std::shared_mutex> lock(table.mutex);
+    return PREDEFINED_NAMES + table.names.size();
+}
\ No newline at end of file
@@ -0,0 +1,225 @@
+#pragma once
+#ifndef ATOM_TABLE_H
+#define ATOM_TABLE_H
+
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+
+// Tag and attribute names are interned into process-wide atoms: small
+// integers that compare in one instruction and cost a node 4 bytes instead
+// of a string. Names are case-sensitive, as ElementNode always stored them.
+//
+// Well-known HTML tag and attribute names are predefined at compile time
+// (kept sorted, so they are found without locking); any other name gets an
+// atom the first time it is interned and keeps it for the process lifetime.
+// Run-time names come from documents, which may be hostile, so there are at
+// most MAX_DYNAMIC_ATOMS of them; past that, intern() returns Atoms::Null
+// and elements keep the name as a string of their own (see ElementNode).
+typedef uint32_t Atom;
+
+#define DOM_PREDEFINED_ATOMS(X) \
+    X(a, "a") \
+    X(abbr, "abbr") \
+    X(accept, "accept") \
+    X(action, "action") \
+    X(address, "address") \
+    X(alt, "alt") \
+    X(area, "area") \
+    X(article, "article") \
+    X(aside, "aside") \
+    X(async, "async") \
+    X(audio, "audio") \
+    X(autocomplete, "autocomplete") \
+    X(autofocus, "autofocus") \
+    X(b, "b") \
+    X(base, "base") \
+    X(blockquote, "blockquote") \
+    X(body, "body") \
+    X(br, "br") \
+    X(button, "button") \
+    X(canvas, "canvas") \
+    X(caption, "caption") \
+    X(charset, "charset") \
+    X(checked, "checked") \
+    X(class_, "class") \
+    X(code, "code") \
+    X(col, "col") \
+    X(colgroup, "colgroup") \
+    X(cols, "cols") \
+    X(colspan, "colspan") \
+    X(content, "content") \
+    X(contenteditable, "contenteditable") \
+    X(controls, "controls") \
+    X(coords, "coords") \
+    X(crossorigin, "crossorigin") \
+    X(data, "data") \
+    X(datalist, "datalist") \
+    X(dd, "dd") \
+    X(defer, "defer") \
+    X(del, "del") \
+    X(details, "details") \
+    X(dfn, "dfn") \
+    X(dialog, "dialog") \
+    X(dir, "dir") \
+    X(disabled, "disabled") \
+    X(div, "div") \
+    X(dl, "dl") \
+    X(download, "download") \
+    X(draggable, "draggable") \
+    X(dt, "dt") \
+    X(em, "em") \
+    X(embed, "embed") \
+    X(enctype, "enctype") \
+    X(fieldset, "fieldset") \
+    X(figcaption, "figcaption") \
+    X(figure, "figure") \
+    X(footer, "footer") \
+    X(for_, "for") \
+    X(form, "form") \
+    X(h1, "h1") \
+    X(h2, "h2") \
+    X(h3, "h3") \
+    X(h4, "h4") \
+    X(h5, "h5") \
+    X(h6, "h6") \
+    X(head, "head") \
+    X(header, "header") \
+    X(height, "height") \
+    X(hidden, "hidden") \
+    X(hr, "hr") \
+    X(href, "href") \
+    X(hreflang, "hreflang") \
+    X(html, "html") \
+    X(http_equiv, "http-equiv") \
+    X(i, "i") \
+    X(id, "id") \
+    X(iframe, "iframe") \
+    X(img, "img") \
+    X(input, "input") \
+    X(ins, "ins") \
+    X(kbd, "kbd") \
+    X(label, "label") \
+    X(lang, "lang") \
+    X(legend, "legend") \
+    X(li, "li") \
+    X(link, "link") \
+    X(list, "list") \
+    X(loop, "loop") \
+    X(main, "main") \
+    X(map, "map") \
+    X(mark, "mark") \
+    X(max, "max") \
+    X(maxlength, "maxlength") \
+    X(media, "media") \
+    X(meta, "meta") \
+    X(meter, "meter") \
+    X(method, "method") \
+    X(min, "min") \
+    X(multiple, "multiple") \
+    X(name, "name") \
+    X(nav, "nav") \
+    X(noscript, "noscript") \
+    X(novalidate, "novalidate") \
+    X(object, "object") \
+    X(ol, "ol") \
+    X(onclick, "onclick") \
+    X(onload, "onload") \
+    X(optgroup, "optgroup") \
+    X(option, "option") \
+    X(output, "output") \
+    X(p, "p") \
+    X(param, "param") \
+    X(pattern, "pattern") \
+    X(picture, "picture") \
+    X(placeholder, "placeholder") \
+    X(poster, "poster") \
+    X(pre, "pre") \
+    X(progress, "progress") \
+    X(q, "q") \
+    X(readonly, "readonly") \
+    X(rel, "rel") \
+    X(required, "required") \
+    X(role, "role") \
+    X(root, "root") \
+    X(rows, "rows") \
+    X(rowspan, "rowspan") \
+    X(s, "s") \
+    X(samp, "samp") \
+    X(sandbox, "sandbox") \
+    X(scope, "scope") \
+    X(script, "script") \
+    X(section, "section") \
+    X(select, "select") \
+    X(selected, "selected") \
+    X(shape, "shape") \
+    X(size, "size") \
+    X(sizes, "sizes") \
+    X(small, "small") \
+    X(source, "source") \
+    X(span, "span") \
+    X(src, "src") \
+    X(srcdoc, "srcdoc") \
+    X(srclang, "srclang") \
+    X(srcset, "srcset") \
+    X(start, "start") \
+    X(step, "step") \
+    X(strong, "strong") \
+    X(style, "style") \
+    X(sub, "sub") \
+    X(summary, "summary") \
+    X(sup, "sup") \
+    X(svg, "svg") \
+    X(tabindex, "tabindex") \
+    X(table, "table") \
+    X(target, "target") \
+    X(tbody, "tbody") \
+    X(td, "td") \
+    X(template_, "template") \
+    X(textarea, "textarea") \
+    X(tfoot, "tfoot") \
+    X(th, "th") \
+    X(thead, "thead") \
+    X(time, "time") \
+    X(title, "title") \
+    X(tr, "tr") \
+    X(track, "track") \
+    X(type, "type") \
+    X(u, "u") \
+    X(ul, "ul") \
+    X(usemap, "usemap") \
+    X(value, "value") \
+    X(var, "var") \
+    X(video, "video") \
+    X(wbr, "wbr") \
+    X(width, "width") \
+    X(wrap, "wrap")
+
+namespace Atoms {
+    enum : Atom {
+        Null = 0,   // no name; returned by intern() once the table is full
+#define DOM_ATOM_ENUM(identifier, name) identifier,
+        DOM_PREDEFINED_ATOMS(DOM_ATOM_ENUM)
+#undef DOM_ATOM_ENUM
+        PredefinedCount
+    };
+}
+
+class AtomTable {
+public:
+    static const size_t MAX_DYNAMIC_ATOMS = 16384;
+
+    // Returns the atom for name, adding it if it is new and there is room,
+    // and Atoms::Null if there is not. Thread-safe.
+    static Atom intern(std::string_view name);
+    // Returns the atom for name if it was ever interned and Atoms::Null
+    // otherwise, so lookups of unknown names never grow the table
+    static Atom find(std::string_view name);
+    // The interned name; valid for the process lifetime
+    static std::string_view name(Atom atom);
+
+    static bool isPredefined(Atom atom) { return atom > Atoms::Null && atom < Atoms::PredefinedCount; }
+    static size_t size();
+};
+
+#endif // ATOM_TABLE_H
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include "attribute_map.h"
+#include <new>
+#include <utility>
+
+AttributeMap::AttributeMap(std::pmr::memory_resource* resource)
+    : attributes(inlineAttributes), count(0), capacity(INLINE_CAPACITY), idSlot(-1), classSlot(-1), resource(resource) {}
+
+AttributeMap::AttributeMap(const AttributeMap& other) : AttributeMap() {
+    for (const Attribute& attr : other) set(attr.name, DOMString(attr.value));
+}
+
+AttributeMap::~AttributeMap() {
+    releaseSpilled();
+}
+
+void AttributeMap::releaseSpilled() {
+    if (attributes == inlineAttributes) return;
+    for (uint32_t i = 0; i < capacity; i++) attributes[i].~Attribute();
+    resource->deallocate(attributes, capacity * sizeof(Attribute), alignof(Attribute));
+}
+
+void AttributeMap::grow() {
+    uint32_t newCapacity = capacity * 2;
+    void* memory = resource->allocate(newCapacity * sizeof(Attribute), alignof(Attribute));
+    Attribute* grown = static_cast<Attribute*>(memory);
+    for (uint32_t i = 0; i < newCapacity; i++) new (&grown[i]) Attribute();
+    for (uint32_t i = 0; i < count; i++) {
+        grown[i].name = attributes[i].name;
+        grown[i].value = std::move(attributes[i].value);
+    }
+    releaseSpilled();
+    attributes = grown;
+    capacity = newCapacity;
+}
+
+void AttributeMap::set(Atom name, DOMString&& value) {
+    uint32_t pos = 0;
+    while (pos < count && attributes[pos].name < name) pos++;
+    if (pos < count && attributes[pos].name == name) {
+        attributes[pos].value = std::move(value);
+        return;
+    }
+
+    if (count == capacity) grow();
+    for (uint32_t i = count; i > pos; i--) {
+        attributes[i].name = attributes[i - 1].name;
+        attributes[i].value = std::move(attributes[i - 1].value);
+    }
+    attributes[pos].name = name;
+    attributes[pos].value = std::move(value);
+    count++;
+
+    // Entries at or after pos moved up by one
+    if (idSlot >= static_cast<int>(pos)) idSlot++;
+    if (classSlot >= static_cast<int>(pos)) classSlot++;
+    if (name == Atoms::id) idSlot = static_cast<int16_t>(pos);
+    if (name == Atoms::class_) classSlot = static_cast<int16_t>(pos);
+}
\ No newline at end of file
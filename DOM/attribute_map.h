@@ -0,0 +1,65 @@
+#pragma once
+#ifndef ATTRIBUTE_MAP_H
+#define ATTRIBUTE_MAP_H
+
+#include "dom_string.h"
+#include "atom_table.h"
+#include <memory_resource>
+#include <cstdint>
+#include <cstddef>
+
+// Attribute storage of an ElementNode: a flat array of (atom, value) pairs
+// kept sorted by atom, with room for INLINE_CAPACITY attributes inside the
+// element itself. Larger sets spill to an array from the element's memory
+// resource. id and class, which every index build and selector match asks
+// for, are found through dedicated slot indices without a search.
+class AttributeMap {
+public:
+    struct Attribute {
+        Atom name;
+        DOMString value;
+    };
+
+    static const size_t INLINE_CAPACITY = 3;
+
+private:
+    Attribute inlineAttributes[INLINE_CAPACITY];
+    Attribute* attributes;                  // inlineAttributes or a spilled array
+    uint32_t count;
+    uint32_t capacity;
+    int16_t idSlot;                         // index of id, or -1
+    int16_t classSlot;                      // index of class, or -1
+    std::pmr::memory_resource* resource;    // for spilled arrays
+
+    void grow();
+    void releaseSpilled();
+
+public:
+    explicit AttributeMap(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    // Copies own their values on the default heap, like DOMString copies
+    AttributeMap(const AttributeMap& other);
+    AttributeMap& operator=(const AttributeMap&) = delete;
+    ~AttributeMap();
+
+    // Null if there is no attribute called name
+    const DOMString* find(Atom name) const {
+        if (name == Atoms::id) return idSlot >= 0 ? &attributes[idSlot].value : nullptr;
+        if (name == Atoms::class_) return classSlot >= 0 ? &attributes[classSlot].value : nullptr;
+        for (uint32_t i = 0; i < count && attributes[i].name <= name; i++) {
+            if (attributes[i].name == name) return &attributes[i].value;
+        }
+        return nullptr;
+    }
+
+    void set(Atom name, DOMString&& value);
+
+    size_t size() const { return count; }
+    // Bytes of the spilled array, if there is one
+    size_t spilledBytes() const { return attributes == inlineAttributes ? 0 : capacity * sizeof(Attribute); }
+    bool empty() const { return count == 0; }
+    // In atom order
+    const Attribute* begin() const { return attributes; }
+    const Attribute* end() const { return attributes + count; }
+};
+
+#endif // ATTRIBUTE_MAP_H
\ No newline at end of file
@@ -0,0 +1,427 @@
+#include "benchmark.h"
+#include "structural_index.h"
+#include "parser.h"
+#include "dom_util.h"
+#include "flat_document.h"
+#include "node_visitor.h"
+#include "node_traversal.h"
+#include "selector_matcher.h"
+#include "event_dispatcher.h"
+#include "serializer.h"
+#include "allocation_counter.h"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <string_view>
+#include <algorithm>
+#include <thread>
+#include <streambuf>
+
+static std::string replicate(const std::string& html, size_t minBytes) {
+    if (html.empty()) return html;
+    std::string result;
+    result.reserve(minBytes + html.size());
+    while (result.size() < minBytes) result += html;
+    return result;
+}
+
+// Runs fn a few times and reports the best time in milliseconds
+template <typename Fn>
+static double bestTime(Fn fn) {
+    double best = 0;
+    for (int run = 0; run < 5; run++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        fn();
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double, std::milli> elapsed = end - start;
+        if (run == 0 || elapsed.count() < best) best = elapsed.count();
+    }
+    return best;
+}
+
+// Runs fn a few times and reports the best throughput over input in MB/s
+template <typename Fn>
+static double measure(const std::string& input, Fn fn) {
+    double best = 0;
+    for (int run = 0; run < 5; run++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        fn();
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> seconds = end - start;
+        if (seconds.count() > 0) best = std::max(best, input.size() / seconds.count() / (1024.0 * 1024.0));
+    }
+    return best;
+}
+
+// The search pattern parseElement used before the structural index: one
+// find() per token, rescanning bytes earlier searches already touched
+static size_t legacyScan(std::string_view html) {
+    size_t tokens = 0;
+    size_t pos = 0;
+    while (pos < html.size()) {
+        size_t open = html.find('<', pos);
+        if (open == std::string_view::npos) break;
+        size_t close;
+        if (html.compare(open, 4, "<!--") == 0) close = html.find("-->", open);
+        else if (html.compare(open, 9, "<![CDATA[") == 0) close = html.find("]]>", open);
+        else {
+            close = html.find('>', open);
+            size_t attr = open;
+            while (close != std::string_view::npos && (attr = html.find('=', attr + 1)) < close) {
+                attr = html.find('"', attr);
+                if (attr >= close) break;
+                attr = html.find('"', attr + 1);
+                if (attr >= close) break;
+                tokens++;
+            }
+        }
+        if (close == std::string_view::npos) break;
+        pos = close + 1;
+        tokens++;
+    }
+    return tokens;
+}
+
+// The same walk driven by the structural index
+static size_t indexedScan(std::string_view html, StructuralIndex::Scanner scanner) {
+    StructuralIndex index(html, scanner);
+    size_t tokens = 0;
+    size_t pos = 0;
+    while (pos < html.size()) {
+        size_t open = index.find('<', pos);
+        if (open == StructuralIndex::npos) break;
+        size_t close = index.find('>', open);
+        if (close == StructuralIndex::npos) break;
+        bool comment = html.compare(open, 4, "<!--") == 0;
+        if (comment || html.compare(open, 9, "<![CDATA[") == 0) {
+            // Skip to the "-->" or "]]>" terminator, as the parser does
+            char terminator = comment ? '-' : ']';
+            while (close != StructuralIndex::npos && !(html[close - 2] == terminator && html[close - 1] == terminator))
+                close = index.find('>', close + 1);
+            if (close == StructuralIndex::npos) break;
+        }
+        else {
+            size_t attr = open;
+            while ((attr = index.find('=', attr + 1, close)) != StructuralIndex::npos) {
+                attr = index.find('"', attr, close);
+                if (attr == StructuralIndex::npos) break;
+                attr = index.find('"', attr + 1, close);
+                if (attr == StructuralIndex::npos) break;
+                tokens++;
+            }
+        }
+        pos = close + 1;
+        tokens++;
+    }
+    return tokens;
+}
+
+// Counts events only, so timing it measures the tokenizer without a tree
+class EventCounter : public ParseHandler {
+public:
+    size_t events = 0;
+
+    void startElement(std::string_view /*name*/, const AttributeList& /*attributes*/) override { events++; }
+    void endElement(std::string_view /*name*/) override { events++; }
+    void text(std::string_view /*content*/) override { events++; }
+    void cdata(std::string_view /*content*/) override { events++; }
+    void comment(std::string_view /*content*/) override { events++; }
+};
+
+void Benchmark::scannerThroughput(const std::string& html, size_t minBytes) {
+    std::string input = replicate(html, minBytes);
+    if (input.empty()) return;
+
+    volatile size_t sink = 0;
+    double legacy = measure(input, [&] { sink = legacyScan(input); });
+    double scalar = measure(input, [&] { sink = indexedScan(input, StructuralIndex::Scanner::Scalar); });
+    double vector = measure(input, [&] { sink = indexedScan(input, StructuralIndex::Scanner::Vector); });
+    double events = measure(input, [&] { EventCounter counter; DOMParser::parse(input, counter); sink = counter.events; });
+    double parse = measure(input, [&] { sink = DOMParser::parseDocument(input)->getRoot()->getChildren().size(); });
+    ParseOptions parallel;
+    parallel.threads = 0;
+    double parallelParse = measure(input, [&] { sink = DOMParser::parseDocument(input, parallel)->getRoot()->getChildren().size(); });
+    ParseStats stats;
+    parallel.stats = &stats;
+    sink = DOMParser::parseDocument(input, parallel)->getRoot()->getChildren().size();
+    (void)sink;
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Tokenizer scan over " << (input.size() / (1024.0 * 1024.0)) << " MB:\n";
+    std::cout << "  find() per token:          " << legacy << " MB/s\n";
+    std::cout << "  Structural index (scalar): " << scalar << " MB/s\n";
+    std::cout << "  Structural index (" << StructuralIndex::vectorBackend() << "):   " << vector << " MB/s\n";
+    std::cout << "  SAX events, no tree:       " << events << " MB/s\n";
+    std::cout << "  Full parseDocument:        " << parse << " MB/s\n";
+    std::cout << "  Parallel parseDocument (" << std::max(1u, std::thread::hardware_concurrency()) << " threads): " << parallelParse << " MB/s\n";
+    if (stats.chunks > 0) {
+        std::cout << "  Speculative chunks:        " << stats.replayed << " of " << stats.chunks << " replayed, "
+            << stats.retokenized << " tokenized serially\n";
+        if (stats.replayed == 0) std::cerr << "Parallel tokenizer replayed no chunk; every worker log was thrown away\n";
+    }
+    std::cout.unsetf(std::ios::fixed);
+    std::cout << std::setprecision(6);
+}
+
+void Benchmark::indexBuild(const std::string& html, size_t minBytes) {
+    std::string input = replicate(html, minBytes);
+    if (input.empty()) return;
+
+    volatile size_t sink = 0;
+    double separate = measure(input, [&] {
+        auto document = DOMParser::parseDocument(input);
+        sink = document->getIndex().getElementsByTagName("div").size();
+        });
+    ParseOptions indexing;
+    indexing.buildIndex = true;
+    double during = measure(input, [&] {
+        auto document = DOMParser::parseDocument(input, indexing);
+        sink = document->getIndex().getElementsByTagName("div").size();
+        });
+    (void)sink;
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Index build over " << (input.size() / (1024.0 * 1024.0)) << " MB:\n";
+    std::cout << "  Parse, then build index:   " << separate << " MB/s\n";
+    std::cout << "  Index while parsing:       " << during << " MB/s\n";
+    std::cout.unsetf(std::ios::fixed);
+    std::cout << std::setprecision(6);
+}
+
+// Visits every node of the pointer tree, touching what a query would
+static size_t walkTree(const Node* root) {
+    size_t visited = 0;
+    for (const Node* node : preorder(root)) {
+        visited++;
+        if (auto element = nodeCast<ElementNode>(node)) visited += element->getTagAtom() == Atoms::div;
+    }
+    return visited;
+}
+
+static size_t walkFlat(const FlatDocument& document) {
+    size_t visited = 0;
+    for (FlatDocument::Index node = 0; node < document.size(); node++) {
+        visited += 1 + (document.tag(node) == Atoms::div);
+    }
+    return visited;
+}
+
+void Benchmark::flatTraversal(const std::string& html, size_t minBytes) {
+    std::string input = replicate(html, minBytes);
+    if (input.empty()) return;
+
+    auto document = DOMParser::parseDocument(input);
+    const Node* root = document->getRoot();
+    FlatDocument flat(root);
+    double nodes = static_cast<double>(flat.size());
+
+    volatile size_t sink = 0;
+    double treeWalk = bestTime([&] { sink = walkTree(root); });
+    double flatWalk = bestTime([&] { sink = walkFlat(flat); });
+    double treeTag = bestTime([&] { sink = DOMUtil::getElementsByTagName(document->getRoot(), "div").size(); });
+    double flatTag = bestTime([&] { sink = DOMUtil::getElementsByTagName(flat, "div").size(); });
+    double treeClass = bestTime([&] { sink = DOMUtil::querySelectorAll(document->getRoot(), ".nav").size(); });
+    double flatClass = bestTime([&] { sink = DOMUtil::querySelectorAll(flat, ".nav").size(); });
+    QueryOptions parallel;
+    parallel.threads = 0;
+    double parallelClass = bestTime([&] { sink = DOMUtil::querySelectorAll(document->getRoot(), ".nav", parallel).size(); });
+    (void)sink;
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Traversal over " << flat.size() << " nodes (pointer tree vs flat arrays):\n";
+    std::cout << "  Full walk:                 " << treeWalk * 1e6 / nodes << " vs " << flatWalk * 1e6 / nodes << " ns/node\n";
+    std::cout << "  getElementsByTagName:      " << treeTag << " vs " << flatTag << " ms\n";
+    std::cout << "  querySelectorAll(.class):  " << treeClass << " vs " << flatClass << " ms\n";
+    std::cout << "  Same, tree, all threads:   " << parallelClass << " ms\n";
+    std::cout << "  Flat layout:               " << flat.memoryUsage() / nodes << " bytes/node, text included\n";
+    std::cout << "  Pointer tree:              " << sizeof(ElementNode) << " bytes per element header alone\n";
+    std::cout.unsetf(std::ios::fixed);
+    std::cout << std::setprecision(6);
+}
+
+// Node kinds counted the way traversals did before Node::nodeType(): a chain
+// of dynamic_casts per node
+static void classifyWithRTTI(const Node* root, size_t counts[3]) {
+    for (const Node* node : preorder(root)) {
+        if (dynamic_cast<const ElementNode*>(node)) counts[0]++;
+        else if (dynamic_cast<const TextNode*>(node)) counts[1]++;
+        else if (dynamic_cast<const CDATANode*>(node)) counts[2]++;
+    }
+}
+
+class KindCounter : public NodeVisitor<KindCounter> {
+public:
+    size_t counts[3] = {};
+
+    bool visitElement(ElementNode*) { counts[0]++; return true; }
+    bool visitText(TextNode*) { counts[1]++; return true; }
+    bool visitCDATA(CDATANode*) { counts[2]++; return true; }
+};
+
+void Benchmark::nodeDispatch(const std::string& html, size_t minBytes) {
+    std::string input = replicate(html, minBytes);
+    if (input.empty()) return;
+
+    auto document = DOMParser::parseDocument(input);
+    Node* root = document->getRoot();
+
+    volatile size_t sink = 0;
+    size_t nodes = 0;
+    double rtti = bestTime([&] {
+        size_t counts[3] = {};
+        classifyWithRTTI(root, counts);
+        nodes = counts[0] + counts[1] + counts[2];
+        sink = counts[0];
+        });
+    double visitor = bestTime([&] {
+        KindCounter counter;
+        counter.walk(root);
+        sink = counter.counts[0];
+        });
+    (void)sink;
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Node kind dispatch over " << nodes << " nodes:\n";
+    std::cout << "  dynamic_cast chain:        " << nodes / (rtti * 1e3) << " M nodes/s\n";
+    std::cout << "  NodeVisitor (nodeType):    " << nodes / (visitor * 1e3) << " M nodes/s\n";
+    std::cout.unsetf(std::ios::fixed);
+    std::cout << std::setprecision(6);
+}
+
+// Reads what queries read from every node
+class AccessorWalker : public NodeVisitor<AccessorWalker> {
+public:
+    size_t sink = 0;
+
+    bool visitElement(ElementNode* element) {
+        sink += element->getTagName().size() + element->getAttribute("class").size() + element->getAttribute(Atoms::id).size();
+        sink += element->hasAttribute("href") + element->hasAttribute(Atoms::src);
+        return true;
+    }
+
+    bool visitText(TextNode* text) {
+        sink += text->getContent().size();
+        return true;
+    }
+};
+
+void Benchmark::allocationCheck(const std::string& html) {
+    if (!AllocationCounter::enabled()) {
+        std::cout << "Heap allocations on read paths: not counted (build the CountAllocations configuration)\n";
+        return;
+    }
+    auto document = DOMParser::parseDocument(html);
+    Node* root = document->getRoot();
+
+    // Everything the checked calls take is built up front
+    std::string missingId = "no-such-id";
+    Selector selector("div.nav");
+    std::vector<ElementNode*> elements = DOMUtil::getElementsByTagName(root, "div");
+    ElementNode* target = elements.empty() ? nullptr : elements.back();
+    size_t calls = 0;
+    for (Node* node : inclusiveAncestors(target)) {
+        if (auto element = nodeCast<ElementNode>(node)) element->addEventListener("click", [&calls](Event*) { calls++; });
+    }
+    Event event("click");
+
+    size_t accessors = AllocationCounter::during([&] {
+        AccessorWalker walker;
+        walker.walk(root);
+        });
+    size_t lookup = AllocationCounter::during([&] { DOMUtil::getElementById(root, missingId); });
+    size_t matching = AllocationCounter::during([&] {
+        for (ElementNode* element : elements) calls += SelectorMatcher::matches(element, selector);
+        });
+    size_t dispatch = AllocationCounter::during([&] {
+        if (target) EventDispatcher::dispatchEvent(target, &event);
+        });
+
+    std::cout << "Heap allocations on read paths:\n";
+    std::cout << "  Accessors over every node: " << accessors << "\n";
+    std::cout << "  getElementById (miss):     " << lookup << "\n";
+    std::cout << "  Selector matching:         " << matching << "\n";
+    std::cout << "  Event dispatch:            " << dispatch << "\n";
+}
+
+// ElementNode::toString() as it was before the Serializer: every element
+// concatenates the strings of its children, so bytes are copied once per
+// ancestor
+static std::string legacyToString(const Node* node) {
+    if (auto text = nodeCast<TextNode>(node)) return std::string(text->getContent());
+    if (auto cdata = nodeCast<CDATANode>(node)) return "<![CDATA[" + std::string(cdata->getContent()) + "]]>";
+    auto element = static_cast<const ElementNode*>(node);
+    std::string result = "<" + std::string(element->getTagName());
+    for (const auto& attr : element->getAttributes()) {
+        result += " " + std::string(AtomTable::name(attr.name)) + "=\"" + std::string(attr.value.view()) + "\"";
+    }
+    for (const auto& attr : element->getUnlistedAttributes()) {
+        result += " " + attr.name.str() + "=\"" + attr.value.str() + "\"";
+    }
+    if (!node->hasChildNodes()) return result + "/>";
+    result += ">";
+    for (const Node* child : node->getChildren()) result += legacyToString(child);
+    return result + "</" + std::string(element->getTagName()) + ">";
+}
+
+// Swallows whatever is written, so stream output is timed without a sink
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize count) override { return count; }
+};
+
+void Benchmark::serialization(const std::string& html, size_t minBytes) {
+    std::string input = replicate(html, minBytes);
+    if (input.empty()) return;
+
+    auto document = DOMParser::parseDocument(input);
+    const Node* root = document->getRoot();
+    SerializeOptions raw;
+    raw.escape = false;
+    SerializeOptions presized = raw;
+    presized.presize = true;
+    // Throughput is reported over the output, which is about the input size
+    std::string output = Serializer::toString(root, raw);
+
+    volatile size_t sink = 0;
+    double legacy = measure(output, [&] { sink = legacyToString(root).size(); });
+    double toString = measure(output, [&] { sink = root->toString().size(); });
+    Serializer reused(raw);
+    std::string buffer;
+    double reusedBuffer = measure(output, [&] {
+        buffer.clear();
+        reused.write(root, buffer);
+        sink = buffer.size();
+        });
+    double presizedString = measure(output, [&] { sink = Serializer::toString(root, presized).size(); });
+    Serializer escaping;
+    double escaped = measure(output, [&] {
+        buffer.clear();
+        escaping.write(root, buffer);
+        sink = buffer.size();
+        });
+    NullBuffer discard;
+    std::ostream stream(&discard);
+    double streamed = measure(output, [&] { sink = reused.write(root, stream); });
+    SerializeOptions parallelOptions = raw;
+    parallelOptions.threads = 0;
+    Serializer parallel(parallelOptions);
+    double parallelString = measure(output, [&] {
+        buffer.clear();
+        parallel.write(root, buffer);
+        sink = buffer.size();
+        });
+    (void)sink;
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Serialization of " << (output.size() / (1024.0 * 1024.0)) << " MB:\n";
+    std::cout << "  Recursive concatenation:   " << legacy << " MB/s\n";
+    std::cout << "  toString():                " << toString << " MB/s\n";
+    std::cout << "  Serializer, reused buffer: " << reusedBuffer << " MB/s\n";
+    std::cout << "  Serializer, presized:      " << presizedString << " MB/s\n";
+    std::cout << "  Serializer, escaping:      " << escaped << " MB/s\n";
+    std::cout << "  Serializer, to ostream:    " << streamed << " MB/s\n";
+    std::cout << "  Serializer, all threads:   " << parallelString << " MB/s\n";
+    std::cout.unsetf(std::ios::fixed);
+    std::cout << std::setprecision(6);
+}
\ No newline at end of file
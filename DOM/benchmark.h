@@ -0,0 +1,39 @@
+#pragma once
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+
+// Micro-benchmarks printed by the demo's performance report. Inputs are
+// replicated until they are large enough to time reliably.
+class Benchmark {
+public:
+    // Tokenizer scan throughput: the per-token std::string::find scan the
+    // parser used before the structural index, against the index built with
+    // the scalar and SIMD scanners
+    static void scannerThroughput(const std::string& html, size_t minBytes = 8 * 1024 * 1024);
+
+    // Parsing followed by building the document's ElementIndex against
+    // filling it during parsing (ParseOptions::buildIndex)
+    static void indexBuild(const std::string& html, size_t minBytes = 8 * 1024 * 1024);
+
+    // Full walks and queries over the pointer tree against the same document
+    // as a FlatDocument, with the memory each layout keeps per node
+    static void flatTraversal(const std::string& html, size_t minBytes = 8 * 1024 * 1024);
+
+    // Classifying every node with dynamic_cast, as traversals used to,
+    // against NodeVisitor's switch on Node::nodeType()
+    static void nodeDispatch(const std::string& html, size_t minBytes = 8 * 1024 * 1024);
+
+    // Counts heap allocations made by node accessors, lookups, selector
+    // matching and event dispatch over html; each should report zero. Needs
+    // a build that counts (see AllocationCounter); other builds skip it.
+    static void allocationCheck(const std::string& html);
+
+    // Output throughput of the recursive string concatenation toString()
+    // used to do against the Serializer into a string, a presized string, with
+    // escaping and into a stream
+    static void serialization(const std::string& html, size_t minBytes = 8 * 1024 * 1024);
+};
+
+#endif // BENCHMARK_H
\ No newline at end of file
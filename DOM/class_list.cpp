@@ -0,0 +1,31 @@
+#include "class_list.h"
+
+ClassList::ClassList(std::pmr::memory_resource* resource)
+    : signature(0), inlineHashes(), count(0), capacity(INLINE_CAPACITY), resource(resource) {}
+
+ClassList::~ClassList() {
+    if (isSpilled()) resource->deallocate(spilled, capacity * sizeof(uint32_t), alignof(uint32_t));
+}
+
+void ClassList::reserve(uint32_t wanted) {
+    if (wanted <= capacity) return;
+    uint32_t* grown = static_cast<uint32_t*>(resource->allocate(wanted * sizeof(uint32_t), alignof(uint32_t)));
+    if (isSpilled()) resource->deallocate(spilled, capacity * sizeof(uint32_t), alignof(uint32_t));
+    spilled = grown;
+    capacity = wanted;
+}
+
+void ClassList::assign(std::string_view classAttr) {
+    uint32_t names = 0;
+    split(classAttr, [&names](std::string_view) { names++; });
+    count = 0;
+    signature = 0;
+    reserve(names);
+
+    split(classAttr, [this](std::string_view className) {
+        uint32_t h = hash(className);
+        if (contains(h)) return;
+        hashes()[count++] = h;
+        signature |= bit(h);
+        });
+}
\ No newline at end of file
@@ -0,0 +1,112 @@
+#pragma once
+#ifndef CLASS_LIST_H
+#define CLASS_LIST_H
+
+#include <memory_resource>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+
+// The class names of an ElementNode as 32-bit hashes, split out of its class
+// attribute once whenever the attribute is set, so that a class check
+// neither tokenizes the attribute nor compares strings unless the hash
+// matches. Each hash is kept once, in the order its name first appears.
+//
+// Next to the hashes the list keeps a 64-bit signature with one bit set per
+// name (see bit()). A name whose bit is clear is not in the list, which
+// rejects almost every element in a class search with a single AND; only
+// when the bit is set are the hashes compared. Up to INLINE_CAPACITY names
+// live inside the element; longer lists spill to an array from the
+// element's memory resource.
+//
+// Names are hashed rather than interned, so class names from untrusted
+// documents and selectors take no process-wide memory and no lock. Two
+// names can share a hash: contains() only says a name may be present, and
+// ElementNode::hasClass() confirms it against the attribute text.
+class ClassList {
+public:
+    static const size_t INLINE_CAPACITY = 2;
+
+private:
+    uint64_t signature;
+    union {
+        uint32_t inlineHashes[INLINE_CAPACITY];
+        uint32_t* spilled;                  // when capacity is above INLINE_CAPACITY
+    };
+    uint32_t count;
+    uint32_t capacity;
+    std::pmr::memory_resource* resource;    // for spilled arrays
+
+    bool isSpilled() const { return capacity > INLINE_CAPACITY; }
+    uint32_t* hashes() { return isSpilled() ? spilled : inlineHashes; }
+    const uint32_t* hashes() const { return isSpilled() ? spilled : inlineHashes; }
+    void reserve(uint32_t wanted);
+
+public:
+    // FNV-1a with a final avalanche, so that every bit depends on every
+    // character and the top six can pick the signature bit
+    static uint32_t hash(std::string_view name) {
+        uint32_t h = 2166136261u;
+        for (char c : name) {
+            h ^= static_cast<unsigned char>(c);
+            h *= 16777619u;
+        }
+        h ^= h >> 16;
+        h *= 0x85EBCA6Bu;
+        h ^= h >> 13;
+        return h;
+    }
+
+    // The signature bit of a name hash
+    static uint64_t bit(uint32_t hash) { return uint64_t(1) << (hash >> 26); }
+
+    // Calls f with each name in a class attribute, split on HTML whitespace;
+    // duplicates included
+    template <typename F>
+    static void split(std::string_view classAttr, F f) {
+        size_t pos = 0;
+        while (pos < classAttr.length()) {
+            size_t start = classAttr.find_first_not_of(" \t\n\r\f\v", pos);
+            if (start == std::string_view::npos) break;
+            size_t end = classAttr.find_first_of(" \t\n\r\f\v", start);
+            if (end == std::string_view::npos) end = classAttr.length();
+            f(classAttr.substr(start, end - start));
+            pos = end;
+        }
+    }
+
+    // Whether classAttr names className, for class attributes kept as text
+    static bool names(std::string_view classAttr, std::string_view className) {
+        bool found = false;
+        split(classAttr, [&](std::string_view name) { found = found || name == className; });
+        return found;
+    }
+
+    explicit ClassList(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    ClassList(const ClassList&) = delete;
+    ClassList& operator=(const ClassList&) = delete;
+    ~ClassList();
+
+    // Replaces the names with those of classAttr
+    void assign(std::string_view classAttr);
+
+    // Whether some name in the list hashes to hash(name)
+    bool contains(uint32_t hash) const {
+        if (!(signature & bit(hash))) return false;
+        const uint32_t* stored = hashes();
+        for (uint32_t i = 0; i < count; i++) {
+            if (stored[i] == hash) return true;
+        }
+        return false;
+    }
+
+    uint64_t getSignature() const { return signature; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    // Bytes of the spilled array, if there is one
+    size_t spilledBytes() const { return isSpilled() ? capacity * sizeof(uint32_t) : 0; }
+    const uint32_t* begin() const { return hashes(); }
+    const uint32_t* end() const { return hashes() + count; }
+};
+
+#endif // CLASS_LIST_H
\ No newline at end of file
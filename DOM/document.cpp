@@ -0,0 +1,56 @@
+#include "document.h"
+
+Document::Document(size_t sizeHint) : arena(sizeHint, &blocks), root(nullptr) {
+    root = createElement("root");
+}
+
+Document::~Document() {
+    // Node destructors are skipped on purpose: everything they own lives in
+    // the arena except listener storage and snapshots, which are released here
+    for (auto element : listenerHosts) element->eventListeners.clear();
+    for (auto element : snapshotHosts) element->snapshot.reset();
+    arena.release();
+}
+
+ElementNode* Document::createElement(std::string_view tagName) {
+    return create<ElementNode>(tagName);
+}
+
+TextNode* Document::createTextNode(std::string_view text) {
+    return create<TextNode>(text);
+}
+
+CDATANode* Document::createCDATASection(std::string_view data) {
+    return create<CDATANode>(data);
+}
+
+std::string_view Document::adoptSource(std::string&& text) {
+    mappedSource.close();
+    source = std::move(text);
+    sourceView = source;
+    return sourceView;
+}
+
+std::string_view Document::adoptSource(MappedFile&& file) {
+    std::string().swap(source);
+    mappedSource = std::move(file);
+    sourceView = mappedSource.view();
+    return sourceView;
+}
+
+MemoryUsage Document::memoryUsage() const {
+    MemoryUsage usage = MemoryUsage::measure(root);
+    usage.sourceBytes = sourceView.size();
+    usage.listenerBytes += listenerHosts.capacity() * sizeof(ElementNode*);
+    usage.snapshotBytes += snapshotHosts.capacity() * sizeof(ElementNode*);
+    if (blocks.bytes > usage.arenaBytes) usage.slackBytes = blocks.bytes - usage.arenaBytes;
+    return usage;
+}
+
+void Document::trackListenerHost(ElementNode* element) {
+    listenerHosts.push_back(element);
+}
+
+void Document::trackSnapshotHost(ElementNode* element) {
+    snapshotHosts.push_back(element);
+}
\ No newline at end of file
@@ -0,0 +1,110 @@
+#pragma once
+#ifndef DOCUMENT_H
+#define DOCUMENT_H
+
+#include "node.h"
+#include "mapped_file.h"
+#include "memory_usage.h"
+#include "element_index.h"
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <functional>
+#include <vector>
+#include <new>
+#include <utility>
+
+// Document owns a bump arena from which all of its nodes and their strings
+// are allocated. Destroying the document releases the arena in one go
+// instead of walking the tree with `delete`.
+//
+// Nodes appended into a document's tree must be created through it
+// (createElement etc.); heap nodes from `new` or clone() are not released by
+// the arena and arena nodes must never be passed to `delete`. Node refuses
+// to link a child allocated differently from its new parent.
+//
+// A document can also keep its source text alive (zero-copy parsing), either
+// as a string or as a mapped file: node strings that point into the retained
+// source are then borrowed instead of copied into the arena.
+class Document {
+    friend class Node;
+private:
+    // Upstream of the arena, keeping count of the bytes in its blocks
+    class BlockCounter : public std::pmr::memory_resource {
+    public:
+        size_t bytes = 0;
+
+    private:
+        void* do_allocate(size_t size, size_t alignment) override {
+            void* block = std::pmr::get_default_resource()->allocate(size, alignment);
+            bytes += size;
+            return block;
+        }
+        void do_deallocate(void* block, size_t size, size_t alignment) override {
+            bytes -= size;
+            std::pmr::get_default_resource()->deallocate(block, size, alignment);
+        }
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+    };
+
+    BlockCounter blocks;                    // declared before the arena it serves
+    std::pmr::monotonic_buffer_resource arena;
+    std::string source;
+    MappedFile mappedSource;
+    std::string_view sourceView;    // whichever of the two holds the source
+    ElementNode* root;
+    std::vector<ElementNode*> listenerHosts;
+    std::vector<ElementNode*> snapshotHosts;
+    mutable ElementIndex index;
+
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        void* memory = arena.allocate(sizeof(T), alignof(T));
+        return new (memory) T(std::forward<Args>(args)..., this);
+    }
+
+public:
+    // sizeHint is used for the first arena block; the parser passes a value
+    // derived from the input length so typical documents need one or two blocks
+    explicit Document(size_t sizeHint = 64 * 1024);
+    ~Document();
+
+    Document(const Document&) = delete;
+    Document& operator=(const Document&) = delete;
+
+    ElementNode* getRoot() const { return root; }
+    // Elements by id, tag and class, built on first use; see ElementIndex
+    const ElementIndex& getIndex() const {
+        index.ensureBuilt(root);
+        return index;
+    }
+    std::pmr::memory_resource* getArena() { return &arena; }
+
+    ElementNode* createElement(std::string_view tagName);
+    TextNode* createTextNode(std::string_view text);
+    CDATANode* createCDATASection(std::string_view data);
+
+    // Takes ownership of the source text so nodes can borrow views into it
+    std::string_view adoptSource(std::string&& text);
+    // Same for a mapped file, which then stays mapped as long as the document
+    std::string_view adoptSource(MappedFile&& file);
+    std::string_view getSource() const { return sourceView; }
+    bool holdsSource(std::string_view text) const {
+        std::less<const char*> before;
+        return !text.empty() && !before(text.data(), sourceView.data())
+            && !before(sourceView.data() + sourceView.size(), text.data() + text.size());
+    }
+
+    // Everything the document holds, by category; walks the tree once
+    MemoryUsage memoryUsage() const;
+    // Arena blocks plus the source, in O(1) for per-request budget checks.
+    // Listener and snapshot storage is only in memoryUsage().
+    size_t reservedBytes() const { return blocks.bytes + sourceView.size(); }
+
+    // Called by ElementNode when the first listener is added to an arena element
+    void trackListenerHost(ElementNode* element);
+    // Called by ElementNode when an arena element first keeps a snapshot
+    void trackSnapshotHost(ElementNode* element);
+};
+
+#endif // DOCUMENT_H
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+#ifndef DOM_STRING_H
+#define DOM_STRING_H
+
+#include <string>
+#include <string_view>
+#include <cstring>
+#include <memory_resource>
+
+// String storage for node text and attribute values.
+//
+// A DOMString either borrows a view into a buffer that outlives it (the
+// source a Document keeps alive in zero-copy mode) or owns a copy allocated
+// from a memory resource. Borrowed strings become owned on their first
+// mutation, so read-only trees never copy their text.
+class DOMString {
+private:
+    const char* data;
+    size_t length;
+    std::pmr::memory_resource* storage;     // null while borrowed
+
+    void release() {
+        if (storage && length) storage->deallocate(const_cast<char*>(data), length, 1);
+    }
+
+public:
+    DOMString() : data(""), length(0), storage(nullptr) {}
+
+    // Copies text into memory from resource
+    DOMString(std::string_view text, std::pmr::memory_resource* resource) : DOMString() {
+        assign(text, resource);
+    }
+
+    // Copies always own their text on the default heap, like pmr containers
+    DOMString(const DOMString& other) : DOMString(other.view(), std::pmr::get_default_resource()) {}
+
+    DOMString(DOMString&& other) noexcept : data(other.data), length(other.length), storage(other.storage) {
+        other.data = "";
+        other.length = 0;
+        other.storage = nullptr;
+    }
+
+    DOMString& operator=(const DOMString& other) {
+        if (this != &other) assign(other.view(), std::pmr::get_default_resource());
+        return *this;
+    }
+
+    DOMString& operator=(DOMString&& other) noexcept {
+        if (this != &other) {
+            release();
+            data = other.data;
+            length = other.length;
+            storage = other.storage;
+            other.data = "";
+            other.length = 0;
+            other.storage = nullptr;
+        }
+        return *this;
+    }
+
+    ~DOMString() { release(); }
+
+    static DOMString borrow(std::string_view text) {
+        DOMString result;
+        result.data = text.data();
+        result.length = text.size();
+        return result;
+    }
+
+    void assign(std::string_view text, std::pmr::memory_resource* resource) {
+        const char* copy = "";
+        if (!text.empty()) {
+            char* buffer = static_cast<char*>(resource->allocate(text.size(), 1));
+            std::memcpy(buffer, text.data(), text.size());
+            copy = buffer;
+        }
+        release();
+        data = copy;
+        length = text.size();
+        storage = resource;
+    }
+
+    std::string_view view() const { return std::string_view(data, length); }
+    std::string str() const { return std::string(data, length); }
+    bool empty() const { return length == 0; }
+    size_t size() const { return length; }
+    bool isBorrowed() const { return storage == nullptr && length != 0; }
+
+    bool operator==(std::string_view other) const { return view() == other; }
+    bool operator!=(std::string_view other) const { return view() != other; }
+};
+
+#endif // DOM_STRING_H
\ No newline at end of file
@@ -1,88 +1,60 @@
 #include "dom_util.h"
+#include "node_visitor.h"
+#include "document.h"
 #include <iostream>
 #include <map>
-#include <sstream>
-#include <queue>
 
-// Initialize static members for caching
-std::map<std::string, ElementNode*> DOMUtil::idCache;
-std::map<std::string, std::vector<ElementNode*>> DOMUtil::tagCache;
-std::map<std::string, std::vector<ElementNode*>> DOMUtil::classCache;
-bool DOMUtil::cacheBuilt = false;
+// Prints each node it visits, indented by depth; offset is added to the depth
+// the walk tracks so single visits can be placed too
+class NodePrinter : public NodeVisitor<NodePrinter> {
+private:
+    int offset;
 
-void DOMUtil::depthFirstTraversal(Node* node, int depth) {
-    if (!node) return;
-    std::string indent(depth * 2, ' ');
-    if (auto elementNode = dynamic_cast<ElementNode*>(node)) {
+    std::string indent() const { return std::string((offset + depth()) * 2, ' '); }
+
+public:
+    explicit NodePrinter(int offset) : offset(offset) {}
+
+    bool visitElement(ElementNode* elementNode) {
+        std::string indent = this->indent();
         std::cout << indent << "Element: " << elementNode->getTagName() << std::endl;
         // Print attributes if present
-        std::string attrValue;
         for (const auto& attrName : { "id", "class", "href", "src" }) {
-            attrValue = elementNode->getAttribute(attrName);
+            std::string_view attrValue = elementNode->getAttribute(attrName);
             if (!attrValue.empty()) {
                 std::cout << indent << "  Attribute: " << attrName << "=\"" << attrValue << "\"" << std::endl;
             }
         }
+        return true;
     }
-    else if (auto textNode = dynamic_cast<TextNode*>(node)) {
-        std::string content = textNode->getContent();
+
+    bool visitText(TextNode* textNode) {
+        std::string_view content = textNode->getContent();
         // Trim and truncate long text content for display
-        if (content.length() > 50) {
-            content = content.substr(0, 47) + "...";
-        }
-        std::cout << indent << "Text: " << content << std::endl;
+        std::cout << indent() << "Text: ";
+        if (content.length() > 50) std::cout << content.substr(0, 47) << "...";
+        else std::cout << content;
+        std::cout << std::endl;
+        return true;
     }
-    else if (auto cdataNode = dynamic_cast<CDATANode*>(node)) {
-        std::cout << indent << "CDATA: " << cdataNode->toString() << std::endl;
+
+    bool visitCDATA(CDATANode* cdataNode) {
+        std::cout << indent() << "CDATA: " << cdataNode->toString() << std::endl;
+        return true;
     }
-    for (const auto& child : node->getChildren()) depthFirstTraversal(child, depth + 1);
+};
+
+void DOMUtil::depthFirstTraversal(Node* node, int depth) {
+    NodePrinter(depth).walk(node);
 }
 
 void DOMUtil::breadthFirstTraversal(Node* root, int maxDepth) {
     if (!root) return;
 
-    // Queue for BFS: pairs of (node, depth)
-    std::queue<std::pair<Node*, int>> nodeQueue;
-    nodeQueue.push({ root, 0 });
-
-    while (!nodeQueue.empty()) {
-        auto& [currentNode, depth] = nodeQueue.front();
-         nodeQueue.pop();
-
-        // Stop if we've reached the maximum depth
-        if (maxDepth >= 0 && depth > maxDepth) {
-            continue;
-        }
-
-        // Process the current node (similar to depthFirstTraversal)
-        std::string indent(depth * 2, ' ');
-        if (auto elementNode = dynamic_cast<ElementNode*>(currentNode)) {
-            std::cout << indent << "Element: " << elementNode->getTagName() << std::endl;
-            // Print attributes if present
-            std::string attrValue;
-            for (const auto& attrName : { "id", "class", "href", "src" }) {
-                attrValue = elementNode->getAttribute(attrName);
-                if (!attrValue.empty()) {
-                    std::cout << indent << "  Attribute: " << attrName << "=\"" << attrValue << "\"" << std::endl;
-                }
-            }
-        }
-        else if (auto textNode = dynamic_cast<TextNode*>(currentNode)) {
-            std::string content = textNode->getContent();
-            // Trim and truncate long text content for display
-            if (content.length() > 50) {
-                content = content.substr(0, 47) + "...";
-            }
-            std::cout << indent << "Text: " << content << std::endl;
-        }
-        else if (auto cdataNode = dynamic_cast<CDATANode*>(currentNode)) {
-            std::cout << indent << "CDATA: " << cdataNode->toString() << std::endl;
-        }
-
-        // Add all children to the queue
-        for (const auto& child : currentNode->getChildren()) {
-            nodeQueue.push({ child, depth + 1 });
-        }
+    // Level by level down to maxDepth, without a queue
+    auto nodes = levelOrder(root, maxDepth);
+    for (auto it = nodes.begin(), end = nodes.end(); it != end; ++it) {
+        NodePrinter(it.depth()).visit(*it);
     }
 }
 
@@ -92,138 +64,213 @@ std::vector<ElementNode*> DOMUtil::getElementsByTagName(Node* root, const std::s
     return result;
 }
 
-ElementNode* DOMUtil::getElementById(Node* root, const std::string& id) {
-    if (!root) return nullptr;
-    if (auto element = dynamic_cast<ElementNode*>(root)) {
-        if (element->getAttribute("id") == id) return element;
-    }
-    for (auto child : root->getChildren()) {
-        if (auto found = getElementById(child, id)) return found;
+// Stops the walk at the first element whose id matches
+class IdFinder : public NodeVisitor<IdFinder> {
+private:
+    const std::string& id;
+
+public:
+    ElementNode* found = nullptr;
+
+    explicit IdFinder(const std::string& id) : id(id) {}
+
+    bool visitElement(ElementNode* element) {
+        if (element->getAttribute(Atoms::id) == id) found = element;
+        return !found;
     }
-    return nullptr;
+};
+
+ElementNode* DOMUtil::getElementById(Node* root, const std::string& id) {
+    IdFinder finder(id);
+    finder.walk(root);
+    return finder.found;
 }
 
-std::vector<ElementNode*> DOMUtil::querySelectorAll(Node* root, const std::string& selector) {
+// Collects the elements ElementNode::matchesSelector accepts
+class SelectorCollector : public NodeVisitor<SelectorCollector> {
+private:
+    const std::string& selector;
+
+public:
     std::vector<ElementNode*> result;
 
-    // Simple query selector implementation (you can expand it based on your requirements)
-    std::function<void(Node*)> traverse = [&traverse, &result, &selector](Node* node) {
-        if (!node) return;
+    explicit SelectorCollector(const std::string& selector) : selector(selector) {}
 
-        if (auto elementNode = dynamic_cast<ElementNode*>(node)) {
-            // Match the selector (you can improve this with more advanced matching)
-            if (elementNode->matchesSelector(selector)) {
-                result.push_back(elementNode);
-            }
-        }
+    bool visitElement(ElementNode* elementNode) {
+        if (elementNode->matchesSelector(selector)) result.push_back(elementNode);
+        return true;
+    }
+};
 
-        // Recursively traverse children
-        for (auto& child : node->getChildren()) {
-            traverse(child);
-        }
-        };
+// Collects the elements that have a class, checked on their class lists
+class ClassCollector : public NodeVisitor<ClassCollector> {
+private:
+    std::string_view className;
+    uint32_t hash;
 
-    traverse(root);  // Start traversal from the root node
-    return result;
-}
-void DOMUtil::collectElementsByTagName(Node* node, const std::string& tagName, std::vector<ElementNode*>& result) {
-    if (!node) return;
-    if (auto elementNode = dynamic_cast<ElementNode*>(node)) {
-        if (elementNode->getTagName() == tagName) result.push_back(elementNode);
-    }
-    for (const auto& child : node->getChildren()) {
-        collectElementsByTagName(child, tagName, result);
+public:
+    std::vector<ElementNode*> result;
+
+    explicit ClassCollector(std::string_view className) : className(className), hash(ClassList::hash(className)) {}
+
+    bool visitElement(ElementNode* elementNode) {
+        if (elementNode->hasClass(className, hash)) result.push_back(elementNode);
+        return true;
     }
-}
+};
 
-// Cache building methods
-void DOMUtil::buildCache(Node* root) {
-    // Clear existing caches
-    idCache.clear();
-    tagCache.clear();
-    classCache.clear();
+std::vector<ElementNode*> DOMUtil::querySelectorAll(Node* root, const std::string& selector) {
+    // Plain tag selectors compare atoms instead of names
+    if (selector[0] != '#' && selector[0] != '.') return getElementsByTagName(root, selector);
+
+    if (selector[0] == '.') {
+        ClassCollector collector(std::string_view(selector).substr(1));
+        collector.walk(root);
+        return std::move(collector.result);
+    }
 
-    // Build new caches
-    traverseAndBuildCache(root);
-    cacheBuilt = true;
+    SelectorCollector collector(selector);
+    collector.walk(root);
+    return std::move(collector.result);
 }
 
-void DOMUtil::traverseAndBuildCache(Node* node) {
-    if (!node) return;
+std::vector<ElementNode*> DOMUtil::querySelectorAll(Node* root, const std::string& selector, const QueryOptions& options) {
+    if (selector[0] == '.') {
+        std::string_view className = std::string_view(selector).substr(1);
+        uint32_t hash = ClassList::hash(className);
+        return ParallelQuery::collect(root, options, [className, hash](ElementNode* element) { return element->hasClass(className, hash); });
+    }
+    if (selector[0] != '#') {
+        // A tag name without an atom only matches elements created once the
+        // AtomTable was full
+        Atom name = AtomTable::find(selector);
+        std::string_view tag = selector;
+        return ParallelQuery::collect(root, options, [name, tag](ElementNode* element) { return element->isTag(name, tag); });
+    }
+    return ParallelQuery::collect(root, options, [&selector](ElementNode* element) { return element->matchesSelector(selector); });
+}
 
-    if (auto elementNode = dynamic_cast<ElementNode*>(node)) {
-        // Cache by tag name
-        std::string tagName = elementNode->getTagName();
-        tagCache[tagName].push_back(elementNode);
+class TagCollector : public NodeVisitor<TagCollector> {
+private:
+    Atom tag;
+    std::string_view tagName;
+    std::vector<ElementNode*>& result;
 
-        // Cache by ID (if present)
-        std::string id = elementNode->getAttribute("id");
-        if (!id.empty()) {
-            idCache[id] = elementNode;
-        }
+public:
+    TagCollector(std::string_view tagName, std::vector<ElementNode*>& result)
+        : tag(AtomTable::find(tagName)), tagName(tagName), result(result) {}
 
-        // Cache by class names
-        std::string classAttr = elementNode->getAttribute("class");
-        if (!classAttr.empty()) {
-            std::istringstream iss(classAttr);
-            std::string className;
-            while (iss >> className) {
-                if (!className.empty()) {
-                    classCache[className].push_back(elementNode);
-                }
-            }
-        }
+    bool visitElement(ElementNode* elementNode) {
+        if (elementNode->isTag(tag, tagName)) result.push_back(elementNode);
+        return true;
     }
+};
 
-    // Recurse to children
-    for (const auto& child : node->getChildren()) {
-        traverseAndBuildCache(child);
-    }
+void DOMUtil::collectElementsByTagName(Node* node, std::string_view tagName, std::vector<ElementNode*>& result) {
+    TagCollector(tagName, result).walk(node);
+}
+
+Node* DOMUtil::cacheRoot = nullptr;
+
+void DOMUtil::buildCache(Node* root) {
+    cacheRoot = root;
+    cacheIndex();
 }
 
 void DOMUtil::clearCache() {
-    idCache.clear();
-    tagCache.clear();
-    classCache.clear();
-    cacheBuilt = false;
+    cacheRoot = nullptr;
 }
 
-// Fast lookup methods using cache
-ElementNode* DOMUtil::getElementByIdFast(const std::string& id) {
-    if (!cacheBuilt) {
-        std::cerr << "Warning: Cache not built. Call buildCache() first." << std::endl;
-        return nullptr;
-    }
+const ElementIndex* DOMUtil::cacheIndex() {
+    Document* document = cacheRoot ? cacheRoot->getOwnerDocument() : nullptr;
+    if (!document || document->getRoot() != cacheRoot) return nullptr;
+    return &document->getIndex();
+}
 
-    auto it = idCache.find(id);
-    if (it != idCache.end()) {
-        return it->second;
-    }
-    return nullptr;
+ElementNode* DOMUtil::getElementByIdFast(const std::string& id) {
+    if (const ElementIndex* index = cacheIndex()) return index->getElementById(id);
+    return cacheRoot ? getElementById(cacheRoot, id) : nullptr;
 }
 
 std::vector<ElementNode*> DOMUtil::getElementsByTagNameFast(const std::string& tagName) {
-    if (!cacheBuilt) {
-        std::cerr << "Warning: Cache not built. Call buildCache() first." << std::endl;
-        return {};
+    if (const ElementIndex* index = cacheIndex()) return index->getElementsByTagName(tagName);
+    std::vector<ElementNode*> result;
+    if (cacheRoot) collectElementsByTagName(cacheRoot, tagName, result);
+    return result;
+}
+
+std::vector<ElementNode*> DOMUtil::getElementsByClassNameFast(const std::string& className) {
+    if (const ElementIndex* index = cacheIndex()) return index->getElementsByClassName(className);
+    if (!cacheRoot) return {};
+    ClassCollector collector(className);
+    collector.walk(cacheRoot);
+    return std::move(collector.result);
+}
+
+// FlatDocument queries
+void DOMUtil::depthFirstTraversal(const FlatDocument& document) {
+    std::vector<int> depths(document.size());
+    for (FlatDocument::Index node = 0; node < document.size(); node++) {
+        FlatDocument::Index parent = document.parent(node);
+        depths[node] = (parent == FlatDocument::none) ? 0 : depths[parent] + 1;
+        std::string indent(depths[node] * 2, ' ');
+
+        switch (document.kind(node)) {
+        case FlatDocument::Kind::Element:
+            std::cout << indent << "Element: " << document.tagName(node) << std::endl;
+            // Print attributes if present
+            for (Atom attrName : { Atoms::id, Atoms::class_, Atoms::href, Atoms::src }) {
+                std::string_view attrValue = document.attribute(node, attrName);
+                if (!attrValue.empty()) {
+                    std::cout << indent << "  Attribute: " << AtomTable::name(attrName) << "=\"" << attrValue << "\"" << std::endl;
+                }
+            }
+            break;
+        case FlatDocument::Kind::Text:
+        {
+            std::string content(document.content(node));
+            // Trim and truncate long text content for display
+            if (content.length() > 50) {
+                content = content.substr(0, 47) + "...";
+            }
+            std::cout << indent << "Text: " << content << std::endl;
+        }
+        break;
+        case FlatDocument::Kind::CDATA:
+            std::cout << indent << "CDATA: <![CDATA[" << document.content(node) << "]]>" << std::endl;
+            break;
+        }
     }
+}
 
-    auto it = tagCache.find(tagName);
-    if (it != tagCache.end()) {
-        return it->second;
+std::vector<FlatDocument::Index> DOMUtil::getElementsByTagName(const FlatDocument& document, const std::string& tagName) {
+    std::vector<FlatDocument::Index> result;
+    Atom tag = AtomTable::find(tagName);
+    for (FlatDocument::Index node = 0; node < document.size(); node++) {
+        if (document.isTag(node, tag, tagName)) result.push_back(node);
     }
-    return {};
+    return result;
 }
 
-std::vector<ElementNode*> DOMUtil::getElementsByClassNameFast(const std::string& className) {
-    if (!cacheBuilt) {
-        std::cerr << "Warning: Cache not built. Call buildCache() first." << std::endl;
-        return {};
+FlatDocument::Index DOMUtil::getElementById(const FlatDocument& document, const std::string& id) {
+    for (FlatDocument::Index node = 0; node < document.size(); node++) {
+        if (document.isElement(node) && document.attribute(node, Atoms::id) == id) return node;
     }
+    return FlatDocument::none;
+}
 
-    auto it = classCache.find(className);
-    if (it != classCache.end()) {
-        return it->second;
+std::vector<FlatDocument::Index> DOMUtil::querySelectorAll(const FlatDocument& document, const std::string& selector) {
+    // Same matching rules as ElementNode::matchesSelector
+    if (selector[0] != '#' && selector[0] != '.') return getElementsByTagName(document, selector);
+
+    std::vector<FlatDocument::Index> result;
+    Atom attribute = (selector[0] == '#') ? Atoms::id : Atoms::class_;
+    std::string_view value = std::string_view(selector).substr(1);
+    for (FlatDocument::Index node = 0; node < document.size(); node++) {
+        if (!document.isElement(node)) continue;
+        std::string_view attrValue = document.attribute(node, attribute);
+        bool matches = (attribute == Atoms::id) ? attrValue == value : ClassList::names(attrValue, value);
+        if (matches) result.push_back(node);
     }
-    return {};
+    return result;
 }
\ No newline at end of file
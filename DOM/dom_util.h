@@ -2,10 +2,11 @@
 #ifndef DOM_UTIL_H
 #define DOM_UTIL_H
 #include "node.h"
+#include "flat_document.h"
+#include "parallel_query.h"
 #include <vector>
 #include <string>
 #include <map>
-#include <queue>
 
 class DOMUtil {
 public:
@@ -14,6 +15,9 @@ public:
     static std::vector<ElementNode*> getElementsByTagName(Node* root, const std::string& tagName);
     static ElementNode* getElementById(Node* root, const std::string& id);
     static std::vector<ElementNode*> querySelectorAll(Node* root, const std::string& selector);
+    // Same results, matched on options.threads threads once the tree is
+    // large enough (see ParallelQuery)
+    static std::vector<ElementNode*> querySelectorAll(Node* root, const std::string& selector, const QueryOptions& options);
     // Add querySelector method
     static ElementNode* querySelector(Node* root, const std::string& selector) {
         auto elements = querySelectorAll(root, selector);
@@ -21,19 +25,31 @@ public:
     }
     // New methods
     static void breadthFirstTraversal(Node* root, int maxDepth = -1);
+    // Indexed lookups are on the document: Document::getIndex()
+
+    // The former static cache, kept as thin wrappers for existing callers.
+    // buildCache() picks the tree the *Fast lookups answer for; when that is
+    // a document's root they forward to its ElementIndex, otherwise (heap
+    // trees, subtrees) they walk the tree. The tree must outlive the pick or
+    // be dropped with clearCache() first.
     static void buildCache(Node* root);
     static void clearCache();
     static ElementNode* getElementByIdFast(const std::string& id);
     static std::vector<ElementNode*> getElementsByTagNameFast(const std::string& tagName);
     static std::vector<ElementNode*> getElementsByClassNameFast(const std::string& className);
 
+    // The same queries over a FlatDocument, as linear scans of its arrays;
+    // results are node indices in document order
+    static void depthFirstTraversal(const FlatDocument& document);
+    static std::vector<FlatDocument::Index> getElementsByTagName(const FlatDocument& document, const std::string& tagName);
+    static FlatDocument::Index getElementById(const FlatDocument& document, const std::string& id);
+    static std::vector<FlatDocument::Index> querySelectorAll(const FlatDocument& document, const std::string& selector);
+
 private:
-    static void collectElementsByTagName(Node* node, const std::string& tagName, std::vector<ElementNode*>& result);
-    static std::map<std::string, ElementNode*> idCache;
-    static std::map<std::string, std::vector<ElementNode*>> tagCache;
-    static std::map<std::string, std::vector<ElementNode*>> classCache;
-    static bool cacheBuilt;
-    static void traverseAndBuildCache(Node* node);
+    static Node* cacheRoot;
+    // The index answering for cacheRoot, or null if it has to be walked
+    static const ElementIndex* cacheIndex();
+    static void collectElementsByTagName(Node* node, std::string_view tagName, std::vector<ElementNode*>& result);
 };
 
 #endif // DOM_UTIL_H
\ No newline at end of file
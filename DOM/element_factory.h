@@ -8,7 +8,8 @@
 
 class ElementFactory {
 private:
-    // Pool of reusable elements by tag
+    // Pool of reusable elements by tag; each is a shared clone, so copies of
+    // it share its snapshot and cost O(1) however large the template is
     static std::map<std::string, std::shared_ptr<ElementNode>> elementPool;
 
 public:
@@ -16,10 +17,16 @@ public:
         // Check if we have a template element for this tag
         if (elementPool.find(tagName) == elementPool.end()) {
             // Create a new template element
-            elementPool[tagName] = std::make_shared<ElementNode>(tagName);
+            setTemplate(tagName, ElementNode(tagName));
         }
 
         // Clone the template element
-        return new ElementNode(*elementPool[tagName]);
+        return static_cast<ElementNode*>(elementPool[tagName]->clone());
+    }
+
+    // Makes getElement(tagName) stamp out copies of fragment, children and
+    // attributes included; fragment itself is not kept
+    static void setTemplate(const std::string& tagName, const ElementNode& fragment) {
+        elementPool[tagName].reset(static_cast<ElementNode*>(fragment.clone()));
     }
 };
\ No newline at end of file
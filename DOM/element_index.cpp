@@ -0,0 +1,203 @@
+#include "element_index.h"
+#include "node_visitor.h"
+#include "node_traversal.h"
+#include <set>
+#include <algorithm>
+
+// Source of index stamps; nodes start at 0, outside every index
+static std::atomic<uint32_t> nextEpoch(1);
+
+// Whether a comes before b in document order, for two nodes of one tree; an
+// ancestor comes before its descendants
+static bool precedes(const Node* a, const Node* b) {
+    if (a == b) return false;
+    auto aboveA = ancestors(a);
+    auto aboveB = ancestors(b);
+    auto depthA = std::distance(aboveA.begin(), aboveA.end());
+    auto depthB = std::distance(aboveB.begin(), aboveB.end());
+    const Node* x = a;
+    const Node* y = b;
+    for (; depthA > depthB; depthA--) x = x->getParent();
+    for (; depthB > depthA; depthB--) y = y->getParent();
+    if (x == y) return x == a;
+    while (x->getParent() != y->getParent()) {
+        x = x->getParent();
+        y = y->getParent();
+    }
+
+    // Siblings: step along from both, so the cost is their distance apart
+    const Node* p = x;
+    const Node* q = y;
+    for (;;) {
+        p = p->getNextSibling();
+        if (p == y) return true;
+        if (!p) return false;
+        q = q->getNextSibling();
+        if (q == x) return false;
+        if (!q) return true;
+    }
+}
+
+static ElementIndex::ElementList& entry(ElementIndex::ElementMap& map, std::string_view key) {
+    auto it = map.find(key);
+    if (it == map.end()) it = map.emplace(std::string(key), ElementIndex::ElementList()).first;
+    return it->second;
+}
+
+static void insertInOrder(ElementIndex::ElementList& elements, ElementNode* element, bool atEnd) {
+    if (atEnd || elements.empty() || precedes(elements.back(), element)) {
+        elements.push_back(element);
+        return;
+    }
+    auto position = std::upper_bound(elements.begin(), elements.end(), element,
+        [](const ElementNode* a, const ElementNode* b) { return precedes(a, b); });
+    elements.insert(position, element);
+}
+
+// Drops one occurrence of element from the list under key
+static void erase(ElementIndex::ElementMap& map, std::string_view key, ElementNode* element) {
+    auto it = map.find(key);
+    if (it == map.end()) return;
+    auto position = std::find(it->second.begin(), it->second.end(), element);
+    if (position != it->second.end()) it->second.erase(position);
+    if (it->second.empty()) map.erase(it);
+}
+
+ElementIndex::ElementIndex() : epoch(nextEpoch++), built(false) {}
+
+// Indexes the elements of a subtree in document order
+class IndexBuilder : public NodeVisitor<IndexBuilder> {
+private:
+    ElementIndex& index;
+    bool atEnd;
+
+public:
+    IndexBuilder(ElementIndex& index, bool atEnd) : index(index), atEnd(atEnd) {}
+
+    bool visitElement(ElementNode* elementNode) {
+        if (!index.contains(elementNode)) index.indexElement(elementNode, atEnd);
+        return true;
+    }
+};
+
+void ElementIndex::ensureBuilt(Node* root) {
+    if (isBuilt()) return;
+    std::lock_guard<std::mutex> lock(buildMutex);
+    if (isBuilt()) return;
+    build(root);
+    built.store(true, std::memory_order_release);
+}
+
+void ElementIndex::build(Node* root) {
+    ids.clear();
+    tags.clear();
+    classes.clear();
+    epoch = nextEpoch++;
+    IndexBuilder(*this, true).walk(root);
+}
+
+void ElementIndex::indexElement(ElementNode* element, bool atEnd) {
+    element->indexEpoch = epoch;
+
+    insertInOrder(entry(tags, element->getTagName()), element, atEnd);
+
+    std::string_view id = element->getAttribute(Atoms::id);
+    if (!id.empty()) insertInOrder(entry(ids, id), element, atEnd);
+
+    element->forEachClass([&](std::string_view className) {
+        insertInOrder(entry(classes, className), element, atEnd);
+        });
+}
+
+ElementNode* ElementIndex::getElementById(std::string_view id) const {
+    auto it = ids.find(id);
+    return (it != ids.end()) ? it->second.front() : nullptr;
+}
+
+const ElementIndex::ElementList& ElementIndex::getElementsByTagName(std::string_view tagName) const {
+    static const ElementList none;
+    auto it = tags.find(tagName);
+    return (it != tags.end()) ? it->second : none;
+}
+
+const ElementIndex::ElementList& ElementIndex::getElementsByClassName(std::string_view className) const {
+    static const ElementList none;
+    auto it = classes.find(className);
+    return (it != classes.end()) ? it->second : none;
+}
+
+void ElementIndex::subtreeInserted(Node* node) {
+    // Below the last node of the document, which is where the parser
+    // appends, the subtree goes at the end of every list
+    bool atEnd = true;
+    for (const Node* ancestor : inclusiveAncestors(node)) {
+        if (ancestor->getParent() && ancestor->getNextSibling()) {
+            atEnd = false;
+            break;
+        }
+    }
+    IndexBuilder(*this, atEnd).walk(node);
+}
+
+// Unindexes the elements of a subtree, noting the lists they were in
+class IndexEraser : public NodeVisitor<IndexEraser> {
+private:
+    ElementIndex& index;
+
+public:
+    std::set<std::string_view> tags;
+    std::set<std::string_view> ids;
+    std::set<std::string_view> classes;
+
+    explicit IndexEraser(ElementIndex& index) : index(index) {}
+
+    bool visitElement(ElementNode* elementNode) {
+        index.unindex(elementNode);
+        tags.insert(elementNode->getTagName());
+        std::string_view id = elementNode->getAttribute(Atoms::id);
+        if (!id.empty()) ids.insert(id);
+        elementNode->forEachClass([this](std::string_view className) { classes.insert(className); });
+        return true;
+    }
+};
+
+// Drops every element that is no longer indexed from the lists under keys,
+// in one pass per list however many of its elements went
+static void purge(const ElementIndex& index, ElementIndex::ElementMap& map, const std::set<std::string_view>& keys) {
+    for (std::string_view key : keys) {
+        auto it = map.find(key);
+        if (it == map.end()) continue;
+        auto& elements = it->second;
+        elements.erase(std::remove_if(elements.begin(), elements.end(),
+            [&index](const ElementNode* element) { return !index.contains(element); }), elements.end());
+        if (elements.empty()) map.erase(it);
+    }
+}
+
+void ElementIndex::subtreeRemoving(Node* node) {
+    IndexEraser eraser(*this);
+    eraser.walk(node);
+    purge(*this, tags, eraser.tags);
+    purge(*this, ids, eraser.ids);
+    purge(*this, classes, eraser.classes);
+}
+
+void ElementIndex::attributeChanging(ElementNode* element, Atom name) {
+    if (name == Atoms::id) {
+        std::string_view value = element->getAttribute(name);
+        if (!value.empty()) erase(ids, value, element);
+    }
+    else {
+        element->forEachClass([&](std::string_view className) { erase(classes, className, element); });
+    }
+}
+
+void ElementIndex::attributeChanged(ElementNode* element, Atom name) {
+    if (name == Atoms::id) {
+        std::string_view value = element->getAttribute(name);
+        if (!value.empty()) insertInOrder(entry(ids, value), element, false);
+    }
+    else {
+        element->forEachClass([&](std::string_view className) { insertInOrder(entry(classes, className), element, false); });
+    }
+}
\ No newline at end of file
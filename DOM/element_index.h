@@ -0,0 +1,79 @@
+#pragma once
+#ifndef ELEMENT_INDEX_H
+#define ELEMENT_INDEX_H
+
+#include "node.h"
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+
+// The elements of one Document by id, tag name and class name.
+//
+// Every Document owns an index, built on first use (or while parsing with
+// ParseOptions::buildIndex) and from then on kept current by the tree's
+// mutation paths: nodes inserted below the root or removed from it, and id
+// and class attributes set on its elements, update it in place, so edits
+// need no rebuild. Lists are in document order; the first element with an
+// id wins, and an element is listed once per class however often its class
+// attribute names it.
+//
+// The first build is serialized by a mutex. After it lookups take no lock,
+// and any number of threads may read at once while no thread changes the
+// document. Lookups return references into the index, valid until the
+// document next changes.
+class ElementIndex {
+    friend class Document;
+    friend class IndexBuilder;
+    friend class IndexEraser;
+
+public:
+    typedef std::vector<ElementNode*> ElementList;
+    typedef std::map<std::string, ElementList, std::less<>> ElementMap;
+
+private:
+    ElementMap ids;
+    ElementMap tags;
+    ElementMap classes;
+    // Stamp of the nodes in this index, unique to it and renewed on every
+    // build, so that emptying the index unindexes all nodes at once
+    uint32_t epoch;
+    std::atomic<bool> built;
+    std::mutex buildMutex;
+
+    ElementIndex();
+
+    void build(Node* root);
+    // atEnd: element follows everything indexed so far and can be appended
+    void indexElement(ElementNode* element, bool atEnd);
+    void unindex(Node* node) { node->indexEpoch = 0; }
+
+public:
+    ElementIndex(const ElementIndex&) = delete;
+    ElementIndex& operator=(const ElementIndex&) = delete;
+
+    // Builds the index of root's subtree unless it is built already; any
+    // number of threads may call this at once
+    void ensureBuilt(Node* root);
+    bool isBuilt() const { return built.load(std::memory_order_acquire); }
+    bool contains(const Node* node) const { return node->indexEpoch == epoch; }
+
+    // Null, or empty lists, when nothing matches
+    ElementNode* getElementById(std::string_view id) const;
+    const ElementList& getElementsByTagName(std::string_view tagName) const;
+    const ElementList& getElementsByClassName(std::string_view className) const;
+
+    // Called by Node's mutation paths: node was linked below, or is about to
+    // be unlinked from, an indexed parent; name (id or class) of an indexed
+    // element is about to change, or has changed
+    void subtreeInserted(Node* node);
+    void subtreeRemoving(Node* node);
+    void attributeChanging(ElementNode* element, Atom name);
+    void attributeChanged(ElementNode* element, Atom name);
+};
+
+#endif // ELEMENT_INDEX_H
\ No newline at end of file
@@ -31,7 +31,7 @@ public:
     virtual ~Event() = default;
 
     // Getters
-    std::string getType() const { return type; }
+    const std::string& getType() const { return type; }
     ElementNode* getTarget() const { return target; }
     ElementNode* getCurrentTarget() const { return currentTarget; }
     EventPhase getPhase() const { return phase; }
@@ -1,6 +1,7 @@
 #pragma once
 #include "event.h"
 #include "node.h"
+#include "node_traversal.h"
 #include <vector>
 
 class EventDispatcher {
@@ -9,23 +10,31 @@ public:
         if (!node || !event) return false;
 
         // Set target
-        ElementNode* target = dynamic_cast<ElementNode*>(node);
+        ElementNode* target = nodeCast<ElementNode>(node);
         if (!target) return false;
         event->setTarget(target);
 
-        // Build propagation path (for capturing and bubbling)
-        std::vector<ElementNode*> path;
-        Node* current = node;
-        while (current) {
-            if (auto element = dynamic_cast<ElementNode*>(current)) {
-                path.insert(path.begin(), element);
-            }
-            current = current->getParent();
+        // Build propagation path (for capturing and bubbling), root first.
+        // Typical depths fit the inline buffer, so dispatch needs no heap.
+        size_t length = 0;
+        for (Node* current : inclusiveAncestors(node)) {
+            if (current->nodeType() == NodeType::Element) length++;
+        }
+        ElementNode* inlinePath[INLINE_PATH_CAPACITY];
+        std::vector<ElementNode*> spilledPath;
+        ElementNode** path = inlinePath;
+        if (length > INLINE_PATH_CAPACITY) {
+            spilledPath.resize(length);
+            path = spilledPath.data();
+        }
+        size_t slot = length;
+        for (Node* current : inclusiveAncestors(node)) {
+            if (auto element = nodeCast<ElementNode>(current)) path[--slot] = element;
         }
 
         // Capturing phase (top-down)
         event->setPhase(EventPhase::CAPTURING_PHASE);
-        for (size_t i = 0; i < path.size() - 1; i++) {
+        for (size_t i = 0; i + 1 < length; i++) {
             event->setCurrentTarget(path[i]);
             invokeListeners(path[i], event);
             if (event->shouldStopPropagation()) break;
@@ -41,11 +50,10 @@ public:
         // Bubbling phase (if event bubbles)
         if (event->getBubbles() && !event->shouldStopPropagation()) {
             event->setPhase(EventPhase::BUBBLING_PHASE);
-            for (size_t i = path.size() - 2; i >= 0; i--) {
-                event->setCurrentTarget(path[i]);
-                invokeListeners(path[i], event);
+            for (size_t i = length - 1; i > 0; i--) {
+                event->setCurrentTarget(path[i - 1]);
+                invokeListeners(path[i - 1], event);
                 if (event->shouldStopPropagation()) break;
-                if (i == 0) break;
             }
         }
 
@@ -53,12 +61,18 @@ public:
     }
 
 private:
+    static const size_t INLINE_PATH_CAPACITY = 64;
+
     static void invokeListeners(ElementNode* node, Event* event) {
         if (!node) return;
 
-        auto listeners = node->getListeners(event->getType());
-        for (auto& listener : listeners) {
-            listener(event);
+        const ListenerList& listeners = node->getListeners(event->getType());
+        // Listeners added meanwhile wait for the next event
+        size_t count = listeners.size();
+        for (size_t i = 0; i < count && i < listeners.size(); i++) {
+            // Held so a listener removing itself cannot free the running function
+            std::shared_ptr<const EventListener> listener = listeners[i];
+            (*listener)(event);
             if (event->shouldStopImmediatePropagation()) break;
         }
     }
@@ -0,0 +1,54 @@
+#include "event_log.h"
+
+void EventLog::startElement(std::string_view name, const AttributeList& attributes) {
+    events.push_back({ Kind::StartElement, static_cast<uint32_t>(attributes.size()), name });
+    this->attributes.insert(this->attributes.end(), attributes.begin(), attributes.end());
+}
+
+void EventLog::endElement(std::string_view name) {
+    events.push_back({ Kind::EndElement, 0, name });
+}
+
+void EventLog::text(std::string_view content) {
+    events.push_back({ Kind::Text, 0, content });
+}
+
+void EventLog::cdata(std::string_view content) {
+    events.push_back({ Kind::CDATA, 0, content });
+}
+
+void EventLog::comment(std::string_view content) {
+    events.push_back({ Kind::Comment, 0, content });
+}
+
+void EventLog::replay(ParseHandler& handler) const {
+    AttributeList tagAttributes;
+    size_t nextAttribute = 0;
+    for (const Event& event : events) {
+        switch (event.kind) {
+        case Kind::StartElement:
+            tagAttributes.assign(attributes.begin() + nextAttribute, attributes.begin() + nextAttribute + event.attributeCount);
+            nextAttribute += event.attributeCount;
+            handler.startElement(event.value, tagAttributes);
+            break;
+        case Kind::EndElement:
+            handler.endElement(event.value);
+            break;
+        case Kind::Text:
+            handler.text(event.value);
+            break;
+        case Kind::CDATA:
+            handler.cdata(event.value);
+            break;
+        case Kind::Comment:
+            handler.comment(event.value);
+            break;
+        }
+        if (handler.done()) return;
+    }
+}
+
+void EventLog::clear() {
+    std::vector<Event>().swap(events);
+    AttributeList().swap(attributes);
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include "parse_handler.h"
+#include <vector>
+#include <cstdint>
+
+// A ParseHandler that records the events it receives so they can be
+// replayed into another handler later, in the same order. Recorded views
+// still point into the parser's input, which must outlive the log.
+//
+// Parallel parsing tokenizes chunks into logs on worker threads and replays
+// them into the tree builder on the calling thread.
+class EventLog : public ParseHandler {
+private:
+    enum class Kind : uint8_t { StartElement, EndElement, Text, CDATA, Comment };
+
+    struct Event {
+        Kind kind;
+        uint32_t attributeCount;    // StartElement only
+        std::string_view value;     // name, or content
+    };
+
+    std::vector<Event> events;
+    AttributeList attributes;       // of all start tags, in order
+
+public:
+    void startElement(std::string_view name, const AttributeList& attributes) override;
+    void endElement(std::string_view name) override;
+    void text(std::string_view content) override;
+    void cdata(std::string_view content) override;
+    void comment(std::string_view content) override;
+
+    // Stops early if handler reports done()
+    void replay(ParseHandler& handler) const;
+    // Drops the events and their memory
+    void clear();
+    bool empty() const { return events.empty(); }
+};
+
+#endif // EVENT_LOG_H
\ No newline at end of file
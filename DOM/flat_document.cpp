@@ -0,0 +1,126 @@
+#include "flat_document.h"
+#include "node_traversal.h"
+#include <algorithm>
+
+FlatDocument::FlatDocument(const Node* root) {
+    attributeStarts.push_back(0);
+    if (!root) return;
+
+    // Pre-order, so indices are in document order; path holds the index of
+    // the current node's ancestor at each depth
+    std::vector<Index> path;
+    std::vector<Index> lastChildren;
+    auto nodes = preorder(root);
+    for (auto it = nodes.begin(), end = nodes.end(); it != end; ++it) {
+        const Node* node = *it;
+        size_t depth = static_cast<size_t>(it.depth());
+        Index parentIndex = (depth > 0) ? path[depth - 1] : none;
+
+        Index index = static_cast<Index>(kinds.size());
+        path.resize(depth);
+        path.push_back(index);
+        parents.push_back(parentIndex);
+        firstChildren.push_back(none);
+        nextSiblings.push_back(none);
+        lastChildren.push_back(none);
+        if (parentIndex != none) {
+            if (lastChildren[parentIndex] == none) firstChildren[parentIndex] = index;
+            else nextSiblings[lastChildren[parentIndex]] = index;
+            lastChildren[parentIndex] = index;
+        }
+
+        switch (node->nodeType()) {
+        case NodeType::Element:
+        {
+            auto element = static_cast<const ElementNode*>(node);
+            kinds.push_back(Kind::Element);
+            tags.push_back(element->tagName);
+            contents.push_back(element->tagName != Atoms::Null ? Range{ 0, 0 } : store(element->getTagName()));
+            for (const auto& attr : element->attributes) {
+                attributeNames.push_back(attr.name);
+                attributeValues.push_back(store(attr.value.view()));
+            }
+            for (const auto& attr : element->getUnlistedAttributes()) {
+                unlistedNames.push_back({ static_cast<uint32_t>(attributeNames.size()), store(attr.name.view()) });
+                attributeNames.push_back(Atoms::Null);
+                attributeValues.push_back(store(attr.value.view()));
+            }
+        }
+        break;
+        case NodeType::Text:
+            kinds.push_back(Kind::Text);
+            tags.push_back(Atoms::Null);
+            contents.push_back(store(static_cast<const TextNode*>(node)->content.view()));
+            break;
+        case NodeType::CDATA:
+            kinds.push_back(Kind::CDATA);
+            tags.push_back(Atoms::Null);
+            contents.push_back(store(static_cast<const CDATANode*>(node)->content.view()));
+            break;
+        }
+        attributeStarts.push_back(static_cast<uint32_t>(attributeNames.size()));
+    }
+}
+
+FlatDocument::Range FlatDocument::store(std::string_view text) {
+    Range range = { static_cast<uint32_t>(pool.size()), static_cast<uint32_t>(text.size()) };
+    pool.append(text.data(), text.size());
+    return range;
+}
+
+FlatDocument::Index FlatDocument::subtreeEnd(Index node) const {
+    for (Index n = node; n != none; n = parents[n]) {
+        if (nextSiblings[n] != none) return nextSiblings[n];
+    }
+    return static_cast<Index>(size());
+}
+
+std::string_view FlatDocument::attribute(Index node, Atom name) const {
+    if (name == Atoms::Null) return std::string_view();
+    for (uint32_t i = attributeStarts[node]; i < attributeStarts[node + 1]; i++) {
+        if (attributeNames[i] == name) return load(attributeValues[i]);
+    }
+    return std::string_view();
+}
+
+bool FlatDocument::hasAttribute(Index node, Atom name) const {
+    if (name == Atoms::Null) return false;
+    for (uint32_t i = attributeStarts[node]; i < attributeStarts[node + 1]; i++) {
+        if (attributeNames[i] == name) return true;
+    }
+    return false;
+}
+
+std::string_view FlatDocument::attributeNameView(Index node, size_t i) const {
+    uint32_t slot = attributeStarts[node] + static_cast<uint32_t>(i);
+    if (attributeNames[slot] != Atoms::Null) return AtomTable::name(attributeNames[slot]);
+    auto it = std::lower_bound(unlistedNames.begin(), unlistedNames.end(), slot,
+        [](const std::pair<uint32_t, Range>& entry, uint32_t slot) { return entry.first < slot; });
+    return load(it->second);
+}
+
+std::string_view FlatDocument::attribute(Index node, std::string_view name) const {
+    Atom atom = AtomTable::find(name);
+    if (atom != Atoms::Null) return attribute(node, atom);
+    for (size_t i = 0; i < attributeCount(node); i++) {
+        if (attributeName(node, i) == Atoms::Null && attributeNameView(node, i) == name) return attributeValue(node, i);
+    }
+    return std::string_view();
+}
+
+bool FlatDocument::hasAttribute(Index node, std::string_view name) const {
+    Atom atom = AtomTable::find(name);
+    if (atom != Atoms::Null) return hasAttribute(node, atom);
+    for (size_t i = 0; i < attributeCount(node); i++) {
+        if (attributeName(node, i) == Atoms::Null && attributeNameView(node, i) == name) return true;
+    }
+    return false;
+}
+
+size_t FlatDocument::memoryUsage() const {
+    return kinds.capacity() * sizeof(Kind) + tags.capacity() * sizeof(Atom)
+        + (parents.capacity() + firstChildren.capacity() + nextSiblings.capacity()) * sizeof(Index)
+        + contents.capacity() * sizeof(Range) + attributeStarts.capacity() * sizeof(uint32_t)
+        + attributeNames.capacity() * sizeof(Atom) + attributeValues.capacity() * sizeof(Range)
+        + unlistedNames.capacity() * sizeof(unlistedNames[0]) + pool.capacity();
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#pragma once
+#ifndef FLAT_DOCUMENT_H
+#define FLAT_DOCUMENT_H
+
+#include "node.h"
+#include "atom_table.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+// Immutable, compact copy of a node tree for read-heavy work.
+//
+// Nodes are numbered in document order (node 0 is the root) and stored as
+// a struct of arrays: one byte of kind, the tag atom and 32-bit parent,
+// first-child and next-sibling indices per node. All text and attribute
+// values share a single character pool. A walk over the document is then
+// a linear scan over a few dense arrays instead of a chase through heap
+// nodes, child vectors and vtables; the descendants of node i are exactly
+// the nodes [i + 1, subtreeEnd(i)).
+class FlatDocument {
+public:
+    typedef uint32_t Index;
+    static constexpr Index none = UINT32_MAX;
+
+    enum class Kind : uint8_t { Element, Text, CDATA };
+
+private:
+    struct Range {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    std::vector<Kind> kinds;
+    std::vector<Atom> tags;                 // Atoms::Null for text and CDATA
+    std::vector<Index> parents;
+    std::vector<Index> firstChildren;
+    std::vector<Index> nextSiblings;
+    std::vector<Range> contents;            // text and CDATA, into pool
+    std::vector<uint32_t> attributeStarts;  // node i owns [starts[i], starts[i + 1])
+    std::vector<Atom> attributeNames;
+    std::vector<Range> attributeValues;     // into pool
+    // Attribute slot and name of each attribute whose name has no atom, by
+    // slot; such attributes are stored under Atoms::Null
+    std::vector<std::pair<uint32_t, Range>> unlistedNames;
+    std::string pool;
+
+    Range store(std::string_view text);
+    std::string_view load(Range range) const { return std::string_view(pool.data() + range.offset, range.length); }
+
+public:
+    explicit FlatDocument(const Node* root);
+
+    size_t size() const { return kinds.size(); }
+    Kind kind(Index node) const { return kinds[node]; }
+    bool isElement(Index node) const { return kinds[node] == Kind::Element; }
+    Atom tag(Index node) const { return tags[node]; }
+    // The tag of an element as a string, also when it has no atom; such
+    // tags are kept in the content range, which elements do not use
+    std::string_view tagName(Index node) const {
+        return tags[node] != Atoms::Null ? AtomTable::name(tags[node]) : load(contents[node]);
+    }
+    // As ElementNode::isTag
+    bool isTag(Index node, Atom tag, std::string_view name) const {
+        if (!isElement(node)) return false;
+        return tag != Atoms::Null ? tags[node] == tag : tags[node] == Atoms::Null && load(contents[node]) == name;
+    }
+    Index parent(Index node) const { return parents[node]; }
+    Index firstChild(Index node) const { return firstChildren[node]; }
+    Index nextSibling(Index node) const { return nextSiblings[node]; }
+    // One past the last descendant of node
+    Index subtreeEnd(Index node) const;
+
+    // Content of a text or CDATA node
+    std::string_view content(Index node) const { return load(contents[node]); }
+    // Empty if node has no attribute called name
+    std::string_view attribute(Index node, Atom name) const;
+    bool hasAttribute(Index node, Atom name) const;
+    // The same by name, for names that may have no atom
+    std::string_view attribute(Index node, std::string_view name) const;
+    bool hasAttribute(Index node, std::string_view name) const;
+    size_t attributeCount(Index node) const { return attributeStarts[node + 1] - attributeStarts[node]; }
+    // The i-th attribute of node, in atom order with those without an atom
+    // last; their name is Atoms::Null and attributeNameView() has it
+    Atom attributeName(Index node, size_t i) const { return attributeNames[attributeStarts[node] + i]; }
+    std::string_view attributeNameView(Index node, size_t i) const;
+    std::string_view attributeValue(Index node, size_t i) const { return load(attributeValues[attributeStarts[node] + i]); }
+
+    // Bytes held by the arrays and the pool
+    size_t memoryUsage() const;
+};
+
+#endif // FLAT_DOCUMENT_H
\ No newline at end of file
@@ -2,7 +2,6 @@
 #include <iostream>
 #include <limits>
 #include <fstream>
-#include <sstream>
 
 int InputHandler::getNumberInput(int min, int max, const std::string& prompt) {
     int choice;
@@ -54,9 +53,35 @@ std::string InputHandler::readFromFile(const std::string& filename) {
         return "";
     }
 
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    return buffer.str();
+    // Read straight into the result instead of through a stringstream copy.
+    // Text mode may shrink the content (CRLF on Windows), hence the resize.
+    file.seekg(0, std::ios::end);
+    std::streamoff size = file.tellg();
+    file.seekg(0, std::ios::beg);
+    if (size <= 0) return "";
+
+    std::string content(static_cast<size_t>(size), '\0');
+    file.read(&content[0], size);
+    content.resize(static_cast<size_t>(file.gcount()));
+    return content;
+}
+
+bool InputHandler::readFromFileInChunks(const std::string& filename,
+    const std::function<void(std::string_view)>& onChunk, size_t chunkSize) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open file: " << filename << std::endl;
+        return false;
+    }
+
+    std::string buffer(chunkSize, '\0');
+    while (file) {
+        file.read(&buffer[0], static_cast<std::streamsize>(buffer.size()));
+        std::streamsize count = file.gcount();
+        if (count <= 0) break;
+        onChunk(std::string_view(buffer.data(), static_cast<size_t>(count)));
+    }
+    return true;
 }
 
 std::string InputHandler::getFileInput() {
@@ -3,6 +3,8 @@
 #define INPUT_HANDLER_H
 
 #include <string>
+#include <string_view>
+#include <functional>
 
 class InputHandler {
 public:
@@ -16,9 +18,16 @@ public:
     static std::string getMultiLineInput(const std::string& prompt,
         const std::string& endMarker = "END");
 
-    // Read HTML from a file
+    // Read HTML from a file. Large files are better mapped with MappedFile
+    // and parsed in place, which avoids this copy altogether.
     static std::string readFromFile(const std::string& filename);
 
+    // Read a file in fixed-size chunks, handing each to onChunk as it arrives
+    // so it can be parsed while the rest is read. Returns false if the file
+    // cannot be opened.
+    static bool readFromFileInChunks(const std::string& filename,
+        const std::function<void(std::string_view)>& onChunk, size_t chunkSize = 64 * 1024);
+
     // Get a filename from user and read its contents
     static std::string getFileInput();
 };
@@ -0,0 +1,42 @@
+#pragma once
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+// Read-only memory mapping of a whole file, so large inputs can be parsed
+// straight from the page cache without being read into a string first.
+// The mapping is hinted for sequential access (madvise on POSIX,
+// FILE_FLAG_SEQUENTIAL_SCAN on Windows), which is how the parser reads it.
+//
+// Empty files cannot be mapped; open() fails for them as for missing ones.
+class MappedFile {
+private:
+    const char* data;
+    size_t length;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#endif
+
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    bool open(const std::string& filename);
+    void close();
+
+    bool isOpen() const { return data != nullptr; }
+    const char* getData() const { return data; }
+    size_t size() const { return length; }
+    std::string_view view() const { return std::string_view(data, length); }
+};
+
+#endif // MAPPED_FILE_H
\ No newline at end of file
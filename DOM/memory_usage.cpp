@@ -0,0 +1,103 @@
+#include "memory_usage.h"
+#include "node.h"
+#include "flat_document.h"
+#include <string>
+#include <functional>
+
+static const size_t LINK_BYTES = 5 * sizeof(Node*);
+// Ahead of its value a std::map node holds a colour and three links in the
+// common implementations
+static const size_t MAP_NODE_HEADER = 4 * sizeof(void*);
+// The counts std::make_shared keeps next to the object: a vtable pointer
+// and the use and weak counts
+static const size_t SHARED_COUNTS = sizeof(void*) + 2 * sizeof(int);
+
+// Characters of text on the heap; none while they fit in the string itself
+static size_t heapBytes(const std::string& text) {
+    const char* object = reinterpret_cast<const char*>(&text);
+    std::less<const char*> before;
+    bool inPlace = !before(text.data(), object) && before(text.data(), object + sizeof(std::string));
+    return inPlace ? 0 : text.capacity() + 1;
+}
+
+MemoryUsage MemoryUsage::measure(const Node* root) {
+    MemoryUsage usage;
+
+    // Pre-order through the raw links, so that children a shared clone has
+    // not created yet stay uncreated
+    const Node* node = root;
+    while (node) {
+        size_t bytes = 0;                   // held by the node in its own allocator
+        switch (node->type) {
+        case NodeType::Element:
+        {
+            const ElementNode* element = static_cast<const ElementNode*>(node);
+            usage.elements++;
+            usage.elementBytes += sizeof(ElementNode) - LINK_BYTES;
+
+            size_t attributes = element->attributes.spilledBytes() + element->classes.spilledBytes();
+            for (const auto& attr : element->attributes) {
+                if (attr.value.isBorrowed()) usage.borrowedBytes += attr.value.size();
+                else attributes += attr.value.size();
+            }
+            if (const auto* unlisted = element->unlisted) {
+                attributes += sizeof(*unlisted) + unlisted->attributes.capacity() * sizeof(ElementNode::UnlistedAttribute);
+                auto count = [&](const DOMString& text) {
+                    if (text.isBorrowed()) usage.borrowedBytes += text.size();
+                    else attributes += text.size();
+                };
+                count(unlisted->tag);
+                for (const auto& attr : unlisted->attributes) {
+                    count(attr.name);
+                    count(attr.value);
+                }
+            }
+            usage.attributeBytes += attributes;
+            bytes = sizeof(ElementNode) + attributes;
+
+            for (const auto& entry : element->eventListeners) {
+                usage.listenerBytes += MAP_NODE_HEADER + sizeof(entry) + heapBytes(entry.first)
+                    + entry.second.capacity() * sizeof(entry.second[0])
+                    + entry.second.size() * (sizeof(EventListener) + SHARED_COUNTS);
+            }
+
+            // A snapshot is counted by the topmost element sharing it
+            const ElementNode* parent = static_cast<const ElementNode*>(node->parent);
+            if (element->snapshot && (node == root || parent->snapshot != element->snapshot)) {
+                usage.snapshotBytes += sizeof(FlatDocument) + SHARED_COUNTS + element->snapshot->memoryUsage();
+            }
+        }
+        break;
+        case NodeType::Text:
+        {
+            const DOMString& content = static_cast<const TextNode*>(node)->content;
+            usage.textNodes++;
+            usage.textBytes += sizeof(TextNode) - LINK_BYTES;
+            if (content.isBorrowed()) usage.borrowedBytes += content.size();
+            else usage.contentBytes += content.size();
+            bytes = sizeof(TextNode) + (content.isBorrowed() ? 0 : content.size());
+        }
+        break;
+        case NodeType::CDATA:
+        {
+            const DOMString& content = static_cast<const CDATANode*>(node)->content;
+            usage.cdataSections++;
+            usage.cdataBytes += sizeof(CDATANode) - LINK_BYTES;
+            if (content.isBorrowed()) usage.borrowedBytes += content.size();
+            else usage.contentBytes += content.size();
+            bytes = sizeof(CDATANode) + (content.isBorrowed() ? 0 : content.size());
+        }
+        break;
+        }
+        usage.linkBytes += LINK_BYTES;
+        if (node->ownerDocument) usage.arenaBytes += bytes;
+
+        if (node->firstChild) {
+            node = node->firstChild;
+            continue;
+        }
+        while (node != root && !node->nextSibling) node = node->parent;
+        node = (node == root) ? nullptr : node->nextSibling;
+    }
+    return usage;
+}
\ No newline at end of file
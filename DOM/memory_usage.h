@@ -0,0 +1,55 @@
+#pragma once
+#ifndef MEMORY_USAGE_H
+#define MEMORY_USAGE_H
+
+#include <cstddef>
+
+class Node;
+
+// Bytes held by a node tree, by what they are spent on.
+//
+// Node objects are counted by type without their five tree links, which are
+// reported together as linkBytes. Strings are counted only where they own
+// their characters: text borrowed from a document's source or a clone's
+// snapshot shows up in borrowedBytes, already counted where it lives. The
+// children of a shared clone that were never reached are not nodes yet;
+// they live in the clone's snapshot, counted once in snapshotBytes by the
+// topmost element sharing it.
+//
+// Heap allocations are counted at their requested size, as the heap's own
+// rounding cannot be known portably. For a Document the arena's slack is
+// known exactly: whatever the arena has reserved beyond the bytes counted
+// here, i.e. block tails, alignment padding and the remains of removed
+// nodes and overwritten strings, which a monotonic arena never reuses.
+//
+// Measuring walks the tree once through its links and allocates nothing.
+// Document::reservedBytes() is the O(1) figure for budget checks.
+struct MemoryUsage {
+    size_t elements = 0;
+    size_t textNodes = 0;
+    size_t cdataSections = 0;
+
+    size_t elementBytes = 0;                // ElementNode objects, attribute slots included
+    size_t textBytes = 0;                   // TextNode objects
+    size_t cdataBytes = 0;                  // CDATANode objects
+    size_t linkBytes = 0;                   // parent, child and sibling pointers
+    size_t attributeBytes = 0;              // spilled attribute and class arrays, owned values
+    size_t contentBytes = 0;                // owned text and CDATA content
+    size_t listenerBytes = 0;               // listener maps, lists and functions
+    size_t snapshotBytes = 0;               // FlatDocuments behind shared clones
+    size_t sourceBytes = 0;                 // source text kept by a document
+    size_t slackBytes = 0;                  // arena bytes reserved but not counted above
+
+    size_t borrowedBytes = 0;               // strings viewed in a source or snapshot, counted there
+    size_t arenaBytes = 0;                  // counted bytes that live in a document arena
+
+    size_t total() const {
+        return elementBytes + textBytes + cdataBytes + linkBytes + attributeBytes + contentBytes
+            + listenerBytes + snapshotBytes + sourceBytes + slackBytes;
+    }
+
+    // Usage of root and its subtree, without anything a document holds
+    static MemoryUsage measure(const Node* root);
+};
+
+#endif // MEMORY_USAGE_H
\ No newline at end of file
@@ -0,0 +1,358 @@
+#pragma once
+#ifndef NODE_TRAVERSAL_H
+#define NODE_TRAVERSAL_H
+
+#include "node.h"
+#include <iterator>
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <type_traits>
+
+// Iterator ranges over a tree, for range-for loops and STL algorithms:
+//
+//     for (Node* node : preorder(root)) ...
+//
+// The iterators move through the parent, child and sibling links, with at
+// most a fixed array of pointers on the side, so a walk over a whole document
+// needs no recursion and inlines into the loop around it. Only level order
+// allocates, and only for levels with more than a few parents. Each range
+// covers root and its descendants only and works on Node and const Node
+// alike. The tree must not change under an iterator.
+//
+// Like the child accessors they are built on, the walks create the children
+// of shared clones as they reach them.
+
+// Document order; depth() is that of the current node below root.
+//
+// On the way down the iterator notes where to resume once each ancestor's
+// subtree is done, i.e. the ancestor's next sibling, so that coming back up
+// costs no reads of the nodes left behind; this keeps pace with a recursive
+// walk, where climbing through the parent links does not. Deeper than
+// INLINE_DEPTH it climbs through the links.
+template <typename N>
+class PreorderIterator {
+private:
+    static const int INLINE_DEPTH = 32;
+
+    N* root;
+    N* node;
+    int level;
+    N* resume[INLINE_DEPTH];                // next sibling of the ancestor at each depth
+
+    void advance(bool descend) {
+        if (descend) {
+            if (N* child = node->getFirstChild()) {
+                if (level < INLINE_DEPTH) resume[level] = (node == root) ? nullptr : node->getNextSibling();
+                node = child;
+                level++;
+                return;
+            }
+        }
+        if (node == root) {
+            node = nullptr;
+            return;
+        }
+        if (N* sibling = node->getNextSibling()) {
+            node = sibling;
+            return;
+        }
+        while (level > INLINE_DEPTH) {
+            node = node->getParent();
+            level--;
+            if (N* sibling = node->getNextSibling()) {
+                node = sibling;
+                return;
+            }
+        }
+        while (level > 0) {
+            level--;
+            if (N* next = resume[level]) {
+                node = next;
+                return;
+            }
+        }
+        node = nullptr;
+    }
+
+public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef N* value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef N* const* pointer;
+    typedef N* reference;
+
+    PreorderIterator(N* root, N* node) : root(root), node(node), level(0) {}
+
+    N* operator*() const { return node; }
+    int depth() const { return level; }
+
+    PreorderIterator& operator++() {
+        advance(true);
+        return *this;
+    }
+    PreorderIterator operator++(int) {
+        PreorderIterator old = *this;
+        advance(true);
+        return old;
+    }
+    // Moves on without entering the current node's children
+    PreorderIterator& skipChildren() {
+        advance(false);
+        return *this;
+    }
+
+    bool operator==(const PreorderIterator& other) const { return node == other.node; }
+    bool operator!=(const PreorderIterator& other) const { return node != other.node; }
+};
+
+// Children before their parent, so root comes last
+template <typename N>
+class PostorderIterator {
+private:
+    N* root;
+    N* node;
+    int level;
+
+    void descend() {
+        while (N* child = node->getFirstChild()) {
+            node = child;
+            level++;
+        }
+    }
+
+public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef N* value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef N* const* pointer;
+    typedef N* reference;
+
+    PostorderIterator(N* root, N* node) : root(root), node(node), level(0) {
+        if (node) descend();
+    }
+
+    N* operator*() const { return node; }
+    int depth() const { return level; }
+
+    PostorderIterator& operator++() {
+        if (node == root) {
+            node = nullptr;
+        }
+        else if (N* sibling = node->getNextSibling()) {
+            node = sibling;
+            descend();
+        }
+        else {
+            node = node->getParent();
+            level--;
+        }
+        return *this;
+    }
+    PostorderIterator operator++(int) {
+        PostorderIterator old = *this;
+        ++*this;
+        return old;
+    }
+
+    bool operator==(const PostorderIterator& other) const { return node == other.node; }
+    bool operator!=(const PostorderIterator& other) const { return node != other.node; }
+};
+
+// Pointers kept inline up to INLINE_SIZE and in a heap array past that
+template <typename N>
+class NodeBuffer {
+private:
+    static const size_t INLINE_SIZE = 16;
+
+    N* slots[INLINE_SIZE];
+    std::vector<N*> spilled;
+    size_t count = 0;
+
+public:
+    size_t size() const { return count; }
+    N* operator[](size_t i) const { return (i < INLINE_SIZE) ? slots[i] : spilled[i - INLINE_SIZE]; }
+
+    void push(N* node) {
+        if (count < INLINE_SIZE) slots[count] = node;
+        else spilled.push_back(node);
+        count++;
+    }
+    void clear() {
+        spilled.clear();
+        count = 0;
+    }
+};
+
+// Breadth first: root, then its children, then theirs, each level in
+// document order, down to maxDepth below root when it is not negative.
+// While it walks a level the iterator notes the nodes of that level that
+// have children, and the next level is their children in turn; each node is
+// reached once, and the side buffers hold two levels' parents, inline while
+// levels are narrow.
+template <typename N>
+class LevelOrderIterator {
+private:
+    N* root;
+    N* node;
+    int level;
+    int maxDepth;
+    NodeBuffer<N> parents;                  // of the level being walked
+    NodeBuffer<N> nextParents;              // nodes of this level with children
+    size_t parent = 0;                      // index of node's parent in parents
+
+public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef N* value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef N* const* pointer;
+    typedef N* reference;
+
+    LevelOrderIterator(N* root, N* node, int maxDepth) : root(root), node(node), level(0), maxDepth(maxDepth) {}
+
+    N* operator*() const { return node; }
+    int depth() const { return level; }
+
+    LevelOrderIterator& operator++() {
+        if ((maxDepth < 0 || level < maxDepth) && node->getFirstChild()) nextParents.push(node);
+
+        if (node != root) {
+            if (N* sibling = node->getNextSibling()) {
+                node = sibling;
+                return *this;
+            }
+            if (++parent < parents.size()) {
+                node = parents[parent]->getFirstChild();
+                return *this;
+            }
+        }
+
+        if (nextParents.size() == 0) {
+            node = nullptr;
+            return *this;
+        }
+        std::swap(parents, nextParents);
+        nextParents.clear();
+        parent = 0;
+        level++;
+        node = parents[0]->getFirstChild();
+        return *this;
+    }
+    LevelOrderIterator operator++(int) {
+        LevelOrderIterator old = *this;
+        ++*this;
+        return old;
+    }
+
+    bool operator==(const LevelOrderIterator& other) const { return node == other.node; }
+    bool operator!=(const LevelOrderIterator& other) const { return node != other.node; }
+};
+
+// Follows one link from node to node until it runs out: parents for
+// ancestors, siblings for the sibling ranges
+template <typename N, N* (*Step)(N*)>
+class LinkIterator {
+private:
+    N* node;
+
+public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef N* value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef N* const* pointer;
+    typedef N* reference;
+
+    explicit LinkIterator(N* node) : node(node) {}
+
+    N* operator*() const { return node; }
+    LinkIterator& operator++() {
+        node = Step(node);
+        return *this;
+    }
+    LinkIterator operator++(int) {
+        LinkIterator old = *this;
+        node = Step(node);
+        return old;
+    }
+
+    bool operator==(const LinkIterator& other) const { return node == other.node; }
+    bool operator!=(const LinkIterator& other) const { return node != other.node; }
+};
+
+template <typename N>
+N* parentOf(N* node) { return node->getParent(); }
+template <typename N>
+N* nextSiblingOf(N* node) { return node->getNextSibling(); }
+template <typename N>
+N* previousSiblingOf(N* node) { return node->getPreviousSibling(); }
+
+// Node or const Node for a pointer to any node class, so that the ranges
+// below accept an ElementNode* and the like
+template <typename T>
+using NodeOf = typename std::conditional<std::is_const<T>::value, const Node, Node>::type;
+
+template <typename Iterator>
+class NodeRange {
+private:
+    Iterator first;
+    Iterator last;
+
+public:
+    NodeRange(Iterator first, Iterator last) : first(first), last(last) {}
+    Iterator begin() const { return first; }
+    Iterator end() const { return last; }
+    bool empty() const { return first == last; }
+};
+
+template <typename T>
+NodeRange<PreorderIterator<NodeOf<T>>> preorder(T* root) {
+    typedef NodeOf<T> N;
+    return NodeRange<PreorderIterator<N>>(PreorderIterator<N>(root, root), PreorderIterator<N>(root, nullptr));
+}
+
+template <typename T>
+NodeRange<PostorderIterator<NodeOf<T>>> postorder(T* root) {
+    typedef NodeOf<T> N;
+    return NodeRange<PostorderIterator<N>>(PostorderIterator<N>(root, root), PostorderIterator<N>(root, nullptr));
+}
+
+template <typename T>
+NodeRange<LevelOrderIterator<NodeOf<T>>> levelOrder(T* root, int maxDepth = -1) {
+    typedef NodeOf<T> N;
+    return NodeRange<LevelOrderIterator<N>>(LevelOrderIterator<N>(root, root, maxDepth),
+        LevelOrderIterator<N>(root, nullptr, maxDepth));
+}
+
+// Parent, grandparent and so on up to the top of the tree
+template <typename T>
+NodeRange<LinkIterator<NodeOf<T>, parentOf<NodeOf<T>>>> ancestors(T* node) {
+    typedef NodeOf<T> N;
+    typedef LinkIterator<N, parentOf<N>> Iterator;
+    return NodeRange<Iterator>(Iterator(node ? node->getParent() : nullptr), Iterator(nullptr));
+}
+
+// node itself, then its ancestors
+template <typename T>
+NodeRange<LinkIterator<NodeOf<T>, parentOf<NodeOf<T>>>> inclusiveAncestors(T* node) {
+    typedef NodeOf<T> N;
+    typedef LinkIterator<N, parentOf<N>> Iterator;
+    return NodeRange<Iterator>(Iterator(node), Iterator(nullptr));
+}
+
+// The siblings after node, nearest first
+template <typename T>
+NodeRange<LinkIterator<NodeOf<T>, nextSiblingOf<NodeOf<T>>>> followingSiblings(T* node) {
+    typedef NodeOf<T> N;
+    typedef LinkIterator<N, nextSiblingOf<N>> Iterator;
+    return NodeRange<Iterator>(Iterator(node ? node->getNextSibling() : nullptr), Iterator(nullptr));
+}
+
+// The siblings before node, nearest first
+template <typename T>
+NodeRange<LinkIterator<NodeOf<T>, previousSiblingOf<NodeOf<T>>>> precedingSiblings(T* node) {
+    typedef NodeOf<T> N;
+    typedef LinkIterator<N, previousSiblingOf<N>> Iterator;
+    return NodeRange<Iterator>(Iterator(node ? node->getPreviousSibling() : nullptr), Iterator(nullptr));
+}
+
+#endif // NODE_TRAVERSAL_H
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+#ifndef NODE_VISITOR_H
+#define NODE_VISITOR_H
+
+#include "node.h"
+#include "node_traversal.h"
+
+// Static visitor over the node kinds. Derived classes pass themselves as
+// Derived and hide the visit methods they care about; dispatch is a switch on
+// Node::nodeType() and the calls resolve at compile time, with no RTTI and no
+// virtual call per node.
+//
+// Each visit method returns whether to go on: walk() stops as soon as one
+// returns false. During walk(), depth() is the depth of the node being
+// visited below the node the walk started at.
+template <typename Derived>
+class NodeVisitor {
+private:
+    int currentDepth = 0;
+
+    Derived& derived() { return static_cast<Derived&>(*this); }
+
+public:
+    bool visitElement(ElementNode*) { return true; }
+    bool visitText(TextNode*) { return true; }
+    bool visitCDATA(CDATANode*) { return true; }
+
+    bool visit(Node* node) {
+        switch (node->nodeType()) {
+        case NodeType::Element:
+            return derived().visitElement(static_cast<ElementNode*>(node));
+        case NodeType::Text:
+            return derived().visitText(static_cast<TextNode*>(node));
+        case NodeType::CDATA:
+            return derived().visitCDATA(static_cast<CDATANode*>(node));
+        }
+        return true;
+    }
+
+    // Pre-order over node and its descendants; false if a visit stopped it
+    bool walk(Node* node) {
+        if (!node) return true;
+        auto nodes = preorder(node);
+        for (auto it = nodes.begin(), end = nodes.end(); it != end; ++it) {
+            currentDepth = it.depth();
+            if (!visit(*it)) {
+                currentDepth = 0;
+                return false;
+            }
+        }
+        currentDepth = 0;
+        return true;
+    }
+
+protected:
+    int depth() const { return currentDepth; }
+};
+
+#endif // NODE_VISITOR_H
\ No newline at end of file
@@ -0,0 +1,230 @@
+#include "parallel_query.h"
+#include "worker_pool.h"
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+
+// Nodes a walk visits between looks at whether another thread needs work
+static const size_t CHECK_INTERVAL = 256;
+
+// The matches of one task in document order: those its own walk found,
+// then those of the tasks it handed on
+struct QueryResults {
+    std::vector<ElementNode*> matches;
+    std::vector<std::unique_ptr<QueryResults>> parts;
+};
+
+// The sibling subtrees from first up to last, which is excluded; a null last
+// takes in all of first's following siblings
+struct QueryTask {
+    Node* first;
+    Node* last;
+    QueryResults* results;
+};
+
+struct QueryQueue {
+    std::mutex mutex;
+    std::deque<QueryTask> tasks;
+};
+
+class QueryPool {
+private:
+    ParallelQuery::Predicate match;
+    const void* context;
+    unsigned threads;
+    size_t serialNodes;
+    std::vector<QueryQueue> queues;         // one per thread
+    WorkerPool::Batch workers;
+    bool parallel = false;                  // set before the workers start
+    size_t walked = 0;                      // by the calling thread until then
+    std::atomic<size_t> queued;             // tasks in some queue or being pushed
+    std::atomic<size_t> unfinished;         // tasks queued or being walked
+    std::atomic<size_t> idle;               // threads looking for a task
+    std::mutex idleMutex;                   // idle threads sleep on idleWake
+    std::condition_variable idleWake;
+
+    // Wakes the idle threads after tasks were queued or the last one ended;
+    // taking idleMutex first keeps the wake from slipping in between an
+    // idle thread's check and its wait
+    void wakeIdle() {
+        { std::lock_guard<std::mutex> lock(idleMutex); }
+        idleWake.notify_all();
+    }
+
+    bool shouldSplit() {
+        if (!parallel) {
+            walked += CHECK_INTERVAL;
+            return threads > 1 && walked >= serialNodes;
+        }
+        return idle.load(std::memory_order_relaxed) > 0 && queued.load(std::memory_order_relaxed) == 0;
+    }
+
+    bool take(size_t self, QueryTask& task) {
+        // Own tasks from the back, the most recently cut and so the smallest;
+        // other threads' from the front
+        for (size_t i = 0; i < queues.size(); i++) {
+            QueryQueue& queue = queues[(self + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty()) continue;
+            if (i == 0) {
+                task = queue.tasks.back();
+                queue.tasks.pop_back();
+            }
+            else {
+                task = queue.tasks.front();
+                queue.tasks.pop_front();
+            }
+            queued--;
+            return true;
+        }
+        return false;
+    }
+
+public:
+    QueryPool(ParallelQuery::Predicate match, const void* context, unsigned threads, size_t serialNodes)
+        : match(match), context(context), threads(threads), serialNodes(serialNodes), queues(threads),
+        queued(0), unfinished(0), idle(0) {}
+
+    bool started() const { return parallel; }
+
+    // Walks task on the calling thread, then helps the other threads finish
+    // if it started them and waits for them to return
+    void run(QueryTask task);
+    void walk(size_t self, QueryTask task);
+    void work(size_t self);
+};
+
+void QueryPool::run(QueryTask task) {
+    unfinished++;
+    walk(0, task);
+    if (--unfinished == 0 && started()) wakeIdle();
+    if (!started()) return;
+    work(0);
+    WorkerPool::shared().finish(workers);
+}
+
+void QueryPool::walk(size_t self, QueryTask task) {
+    Node* last = task.last;
+    Node* top = task.first;                 // the sibling of the range being walked
+    Node* node = top;
+    QueryResults* results = task.results;
+    size_t budget = CHECK_INTERVAL;
+
+    while (node) {
+        if (node->nodeType() == NodeType::Element) {
+            ElementNode* element = static_cast<ElementNode*>(node);
+            if (match(element, context)) results->matches.push_back(element);
+        }
+
+        if (Node* child = node->getFirstChild()) {
+            node = child;
+        }
+        else {
+            while (node != top && !node->getNextSibling()) node = node->getParent();
+            if (node == top) {
+                top = top->getNextSibling();
+                if (top == last) top = nullptr;
+                node = top;
+            }
+            else {
+                node = node->getNextSibling();
+            }
+        }
+
+        if (--budget > 0 || !node) continue;
+        budget = CHECK_INTERVAL;
+        if (!shouldSplit()) continue;
+
+        // Cut what is left into the rest of node's siblings and the rest of
+        // each ancestor's below top, or top alone when node is top, and the
+        // rest of the range; keep the first piece and queue the others
+        std::vector<QueryTask> pieces;
+        Node* next = top->getNextSibling();
+        if (node != top) {
+            pieces.push_back({ node, nullptr, nullptr });
+            for (Node* ancestor = node->getParent(); ancestor != top; ancestor = ancestor->getParent()) {
+                if (Node* following = ancestor->getNextSibling()) pieces.push_back({ following, nullptr, nullptr });
+            }
+        }
+        else {
+            pieces.push_back({ top, next, nullptr });
+        }
+        if (next && next != last) pieces.push_back({ next, last, nullptr });
+        if (pieces.size() < 2) continue;
+
+        for (auto& piece : pieces) {
+            results->parts.push_back(std::make_unique<QueryResults>());
+            piece.results = results->parts.back().get();
+        }
+        // Counted before they are published, so a thread that takes one
+        // straight away never brings queued below zero
+        unfinished += pieces.size() - 1;
+        queued += pieces.size() - 1;
+        {
+            QueryQueue& queue = queues[self];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.insert(queue.tasks.end(), pieces.begin() + 1, pieces.end());
+        }
+        if (!parallel) {
+            parallel = true;
+            WorkerPool::shared().start(workers, threads - 1, [this](unsigned t) { work(t); });
+        }
+        else if (idle.load() > 0) {
+            wakeIdle();
+        }
+
+        last = pieces[0].last;
+        top = node;
+        results = pieces[0].results;
+    }
+}
+
+void QueryPool::work(size_t self) {
+    for (;;) {
+        QueryTask task;
+        if (take(self, task)) {
+            walk(self, task);
+            if (--unfinished == 0) wakeIdle();
+            continue;
+        }
+        if (unfinished.load() == 0) return;
+        idle++;
+        {
+            std::unique_lock<std::mutex> lock(idleMutex);
+            idleWake.wait(lock, [this] { return queued.load() > 0 || unfinished.load() == 0; });
+        }
+        idle--;
+    }
+}
+
+static size_t countMatches(const QueryResults& results) {
+    size_t count = results.matches.size();
+    for (const auto& part : results.parts) count += countMatches(*part);
+    return count;
+}
+
+static void gather(QueryResults& results, std::vector<ElementNode*>& out) {
+    out.insert(out.end(), results.matches.begin(), results.matches.end());
+    for (auto& part : results.parts) gather(*part, out);
+}
+
+std::vector<ElementNode*> ParallelQuery::collect(Node* root, const QueryOptions& options, Predicate match, const void* context) {
+    if (!root) return std::vector<ElementNode*>();
+    unsigned threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+
+    QueryResults results;
+    {
+        QueryPool pool(match, context, threads, options.minParallelNodes);
+        pool.run({ root, root->getNextSibling(), &results });
+        if (!pool.started()) return std::move(results.matches);
+    }
+
+    std::vector<ElementNode*> matches;
+    matches.reserve(countMatches(results));
+    gather(results, matches);
+    return matches;
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+#ifndef PARALLEL_QUERY_H
+#define PARALLEL_QUERY_H
+
+#include "node.h"
+#include <vector>
+#include <cstddef>
+
+struct QueryOptions {
+    // Threads matching parts of the tree side by side; 0 uses every hardware
+    // thread. Results are in document order whatever the count.
+    unsigned threads = 1;
+    // Nodes matched on the calling thread before any other thread starts, so
+    // queries over small trees never pay for them
+    size_t minParallelNodes = 16384;
+};
+
+// Collects the elements of a tree that satisfy a predicate, on several
+// threads when the tree is large.
+//
+// The calling thread walks the tree alone for the first minParallelNodes
+// nodes. If the walk is not done by then, what is left of it (the subtrees
+// following the current node, nearest first) is cut into tasks and the other
+// threads, taken from a pool that outlives the query, join in. Each thread
+// walks its own tasks and steals from the others when it runs out, and sleeps
+// while there is nothing to steal; a walk that finds another thread asleep
+// hands on the rest of its subtree the same way, so no thread waits
+// long behind one large subtree. Every task keeps its matches in a list of
+// its own, ordered behind the matches of the walk it was cut from, and the
+// lists are joined in document order at the end.
+//
+// The tree must not change during a query. The predicate is called from
+// several threads at once; children of shared clones are created by the
+// thread that reaches them.
+class ParallelQuery {
+public:
+    typedef bool (*Predicate)(ElementNode* element, const void* context);
+
+    static std::vector<ElementNode*> collect(Node* root, const QueryOptions& options, Predicate match, const void* context);
+
+    template <typename Match>
+    static std::vector<ElementNode*> collect(Node* root, const QueryOptions& options, const Match& match) {
+        return collect(root, options, [](ElementNode* element, const void* context) {
+            return (*static_cast<const Match*>(context))(element);
+            }, &match);
+    }
+};
+
+#endif // PARALLEL_QUERY_H
\ No newline at end of file
@@ -0,0 +1,33 @@
+#pragma once
+#ifndef PARSE_HANDLER_H
+#define PARSE_HANDLER_H
+
+#include <string_view>
+#include <vector>
+#include <utility>
+
+typedef std::vector<std::pair<std::string_view, std::string_view>> AttributeList;
+
+// Receives the token stream of DOMParser::parse(html, handler) or a
+// handler-driven DOMParser::Session, SAX style, without any tree being built.
+//
+// All views point into the parser's input buffer and are only valid for the
+// duration of the call; copy what has to outlive it. Self-closing tags are
+// reported as startElement followed by endElement, text runs that are only
+// whitespace are skipped and <!DOCTYPE ...> declarations are not reported.
+class ParseHandler {
+public:
+    virtual ~ParseHandler() = default;
+
+    virtual void startElement(std::string_view /*name*/, const AttributeList& /*attributes*/) {}
+    virtual void endElement(std::string_view /*name*/) {}
+    virtual void text(std::string_view /*content*/) {}
+    virtual void cdata(std::string_view /*content*/) {}
+    virtual void comment(std::string_view /*content*/) {}
+
+    // Checked after every event; returning true stops tokenizing, e.g. once
+    // the values a handler was looking for have been seen
+    virtual bool done() const { return false; }
+};
+
+#endif // PARSE_HANDLER_H
\ No newline at end of file
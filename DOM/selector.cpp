@@ -1,11 +1,30 @@
 #include "Selector.h"
-#include <sstream>
 #include <iostream>
 #include <cctype>
 
 // Constructor
 Selector::Selector(const std::string& selectorStr) {
     parts = SelectorParser::tokenize(selectorStr);  // Use the public tokenize function
+    subject = compoundStart(parts.size());
+
+    // Names every match's ancestors must carry between them, for the
+    // AncestorFilter
+    for (size_t i = 0; i < subject; i++) {
+        const SelectorPart& part = parts[i];
+        switch (part.type) {
+        case SelectorType::TAG:
+            ancestorHashes.push_back(AncestorFilter::tagHash(part.name));
+            break;
+        case SelectorType::ID:
+            ancestorHashes.push_back(AncestorFilter::idHash(part.value));
+            break;
+        case SelectorType::CLASS:
+            ancestorHashes.push_back(AncestorFilter::classHash(part.classHash));
+            break;
+        default:
+            break;
+        }
+    }
 }
 
 // Debugging helper to convert the selector to a string for easy viewing
@@ -26,6 +45,10 @@ SelectorPart SelectorParser::parseSimpleSelector(const std::string& selector) {
     if (selector[0] != '.' && selector[0] != '#' && selector[0] != '[') {
         part.type = SelectorType::TAG;
         part.value = selector;
+        // Interned, so a selector kept from before any document used the
+        // name still matches later ones; the table is bounded, and a name it
+        // has no room for is matched by name
+        part.name = AtomTable::intern(part.value);
     }
     // Check if it's an ID (starts with #)
     else if (selector[0] == '#') {
@@ -36,6 +59,7 @@ SelectorPart SelectorParser::parseSimpleSelector(const std::string& selector) {
     else if (selector[0] == '.') {
         part.type = SelectorType::CLASS;
         part.value = selector.substr(1);
+        part.classHash = ClassList::hash(part.value);
     }
     // Attribute selector (starts with [)
     else if (selector[0] == '[') {
@@ -45,22 +69,75 @@ SelectorPart SelectorParser::parseSimpleSelector(const std::string& selector) {
             part.attributeName = selector.substr(1, pos - 1);
             part.attributeValue = selector.substr(pos + 1, selector.length() - pos - 2); // Remove closing bracket
             part.attributeOperator = "=";
+            part.name = AtomTable::intern(part.attributeName);
         }
         else {
             part.value = selector.substr(1, selector.length() - 2); // Remove brackets
+            part.attributeName = part.value;
+            part.name = AtomTable::intern(part.attributeName);
         }
     }
 
     return part;
 }
 
+// Splits a compound such as "div.nav[role=menu]" into its simple selectors
+void SelectorParser::parseCompound(const std::string& compound, std::vector<SelectorPart>& parts) {
+    size_t pos = 0;
+    while (pos < compound.length()) {
+        size_t end;
+        if (compound[pos] == '[') {
+            end = compound.find(']', pos);
+            end = end == std::string::npos ? compound.length() : end + 1;
+        }
+        else {
+            end = compound.find_first_of(".#[", pos + 1);
+            if (end == std::string::npos) end = compound.length();
+        }
+        parts.push_back(parseSimpleSelector(compound.substr(pos, end - pos)));
+        pos = end;
+    }
+}
+
 std::vector<SelectorPart> SelectorParser::tokenize(const std::string& selector) {
     std::vector<SelectorPart> parts;
-    std::stringstream ss(selector);
-    std::string token;
+    bool descendant = false;    // whitespace since the last compound
+    bool child = false;         // '>' since the last compound
+    size_t pos = 0;
 
-    while (ss >> token) {
-        parts.push_back(parseSimpleSelector(token));
+    while (pos < selector.length()) {
+        if (std::isspace(static_cast<unsigned char>(selector[pos]))) {
+            descendant = true;
+            pos++;
+            continue;
+        }
+        if (selector[pos] == '>') {
+            child = true;
+            pos++;
+            continue;
+        }
+
+        // A compound runs up to whitespace or '>' outside of brackets
+        size_t end = pos;
+        while (end < selector.length() && !std::isspace(static_cast<unsigned char>(selector[end])) && selector[end] != '>') {
+            if (selector[end] == '[') {
+                end = selector.find(']', end);
+                end = end == std::string::npos ? selector.length() : end + 1;
+            }
+            else {
+                end++;
+            }
+        }
+
+        if (!parts.empty() && (child || descendant)) {
+            SelectorPart combinator;
+            combinator.type = child ? SelectorType::CHILD : SelectorType::DESCENDANT;
+            combinator.value = child ? ">" : "";
+            parts.push_back(combinator);
+        }
+        parseCompound(selector.substr(pos, end - pos), parts);
+        descendant = child = false;
+        pos = end;
     }
 
     return parts;
@@ -75,25 +152,60 @@ Selector SelectorParser::parse(const std::string& selectorStr) {
     return Selector(selectorStr);  // Or you could directly construct the Selector with the tokenized parts
 }
 
-// Selector matching (you can expand this later)
-bool Selector::match(const ElementNode* element) const {
-    for (const auto& part : parts) {
-        switch (part.type) {
-        case SelectorType::TAG:
-            if (element->getTagName() != part.value) return false;
-            break;
-        case SelectorType::ID:
-            if (element->getAttribute("id") != part.value) return false;
-            break;
-        case SelectorType::CLASS:
-            if (element->getAttribute("class") != part.value) return false;
-            break;
-        case SelectorType::ATTRIBUTE:
-            if (element->getAttribute(part.attributeName) != part.attributeValue) return false;
-            break;
-        default:
-            break;
+bool Selector::matchesPart(const ElementNode* element, const SelectorPart& part) {
+    switch (part.type) {
+    case SelectorType::TAG:
+        return element->isTag(part.name, part.value);
+    case SelectorType::ID:
+        return element->getAttribute(Atoms::id) == part.value;
+    case SelectorType::CLASS:
+        return element->hasClass(part.value, part.classHash);
+    case SelectorType::ATTRIBUTE:
+        // Only a full AtomTable leaves a name without an atom, and then the
+        // attribute can only be an unlisted one
+        if (part.name == Atoms::Null) {
+            if (part.attributeOperator.empty()) return element->hasAttribute(part.attributeName);
+            return element->hasAttribute(part.attributeName) && element->getAttribute(part.attributeName) == part.attributeValue;
         }
+        if (part.attributeOperator.empty()) return element->hasAttribute(part.name);
+        return element->getAttribute(part.name) == part.attributeValue;
+    default:
+        return false;
+    }
+}
+
+bool Selector::matchesCompound(const ElementNode* element, size_t begin, size_t end) const {
+    for (size_t i = begin; i < end; i++) {
+        if (!matchesPart(element, parts[i])) return false;
     }
     return true;
 }
+
+bool Selector::matchesAncestors(const ElementNode* element, size_t combinator) const {
+    size_t begin = compoundStart(combinator);
+    bool child = parts[combinator].type == SelectorType::CHILD;
+
+    // Nearest ancestor first; a descendant combinator moves on to the next
+    // one when the rest of the selector fails from here
+    for (const Node* node = element->getParent(); node; node = node->getParent()) {
+        const ElementNode* ancestor = nodeCast<ElementNode>(node);
+        if (!ancestor) return false;
+        if (matchesCompound(ancestor, begin, combinator) && (begin == 0 || matchesAncestors(ancestor, begin - 1))) return true;
+        if (child) return false;
+    }
+    return false;
+}
+
+// Right to left: the element's own compound, then its ancestors
+bool Selector::match(const ElementNode* element) const {
+    if (!matchesCompound(element, subject, parts.size())) return false;
+    return subject == 0 || matchesAncestors(element, subject - 1);
+}
+
+bool Selector::match(const ElementNode* element, const AncestorFilter& filter) const {
+    if (!matchesCompound(element, subject, parts.size())) return false;
+    for (uint32_t hash : ancestorHashes) {
+        if (!filter.mayContain(hash)) return false;
+    }
+    return subject == 0 || matchesAncestors(element, subject - 1);
+}
\ No newline at end of file
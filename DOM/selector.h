@@ -2,6 +2,8 @@
 #include <string>
 #include <vector>
 #include "node.h" 
+#include "ancestor_filter.h"
+#include <cstdint>
 
 enum class SelectorType {
     TAG,         // e.g., "div"
@@ -14,23 +16,52 @@ enum class SelectorType {
     SIBLING      // e.g., "prev ~ siblings"
 };
 
+inline bool isCombinator(SelectorType type) {
+    return type == SelectorType::CHILD || type == SelectorType::DESCENDANT
+        || type == SelectorType::ADJACENT || type == SelectorType::SIBLING;
+}
+
 struct SelectorPart {
     SelectorType type;
     std::string value;
     std::string attributeName;
     std::string attributeValue;
     std::string attributeOperator; // =, ^=, $=, *=, etc.
+    Atom name = Atoms::Null;       // tag name (TAG) or attributeName (ATTRIBUTE); Null if the AtomTable was full
+    uint32_t classHash = 0;        // ClassList::hash of value (CLASS)
 };
 
+// Compounds of simple parts ("div.nav#top") joined by CHILD and DESCENDANT
+// parts, left to right as written; the last compound is matched against the
+// element itself and the others against its ancestors.
 class Selector {
 private:
     std::vector<SelectorPart> parts;
+    // Tag, id and class hashes of the compounds left of the last combinator
+    std::vector<uint32_t> ancestorHashes;
+    size_t subject = 0;                 // first part of the last compound
+
+    static bool matchesPart(const ElementNode* element, const SelectorPart& part);
+    bool matchesCompound(const ElementNode* element, size_t begin, size_t end) const;
+    // Whether the ancestors of element match everything left of the
+    // combinator at parts[combinator]
+    bool matchesAncestors(const ElementNode* element, size_t combinator) const;
 
 public:
     Selector(const std::string& selectorStr); // Constructor
     const std::vector<SelectorPart>& getParts() const { return parts; }  // Getter for parts
+    const std::vector<uint32_t>& getAncestorHashes() const { return ancestorHashes; }
+    // First part of the compound that ends before parts[end]
+    size_t compoundStart(size_t end) const {
+        while (end > 0 && !isCombinator(parts[end - 1].type)) end--;
+        return end;
+    }
 
     bool match(const ElementNode* element) const;  // Match function
+    // Same, with the ancestors of element pushed into filter; candidates
+    // whose ancestors lack a name the selector needs are turned down from
+    // the filter alone
+    bool match(const ElementNode* element, const AncestorFilter& filter) const;
 
     // Debugging helper
     std::string toString() const;
@@ -43,5 +74,6 @@ public:
     static std::vector<SelectorPart> tokenize(const std::string& selector);
 private:
     static SelectorPart parseSimpleSelector(const std::string& selector);
+    static void parseCompound(const std::string& compound, std::vector<SelectorPart>& parts);
      
-};
+};
\ No newline at end of file
@@ -1,87 +1,118 @@
 #include "selector_matcher.h"
+#include "node_visitor.h"
 #include <iostream>
 
 bool SelectorMatcher::matches(Node* node, const Selector& selector) {
-    // Iterate over the parts of the selector and check if the node matches
-    const auto& parts = selector.getParts();
-    return matchesCompoundSelector(node, parts, 0);
+    // Only elements can match a selector
+    ElementNode* elementNode = nodeCast<ElementNode>(node);
+    return elementNode && selector.match(elementNode);
 }
 
-bool SelectorMatcher::matchesCompoundSelector(Node* node, const std::vector<SelectorPart>& parts, size_t index) {
-    if (index >= parts.size()) {
-        // If we've matched all parts, the node matches the selector
-        return true;
+// Collects the elements matching a parsed selector. When the selector
+// names ancestors, the filter holds the ancestors of the element being
+// visited: those above the root from the start, then the elements the walk
+// is inside of, pushed on the way down and popped on the way up.
+class MatchCollector : public NodeVisitor<MatchCollector> {
+private:
+    const Selector& selector;
+    bool filtered;
+    AncestorFilter filter;
+    size_t aboveRoot = 0;
+
+public:
+    std::vector<ElementNode*> result;
+
+    MatchCollector(const Selector& selector, Node* root)
+        : selector(selector), filtered(!selector.getAncestorHashes().empty()) {
+        if (!filtered) return;
+        for (Node* node : ancestors(root)) {
+            if (auto element = nodeCast<ElementNode>(node)) filter.push(element);
+        }
+        aboveRoot = filter.size();
     }
 
-    const SelectorPart& part = parts[index];
+    bool visitElement(ElementNode* elementNode) {
+        if (!filtered) {
+            if (selector.match(elementNode)) result.push_back(elementNode);
+            return true;
+        }
 
-    // Check if the current node matches the part
-    if (!matchesPart(node, part)) {
-        return false;
+        // Only elements have children, so the walk is inside one element per
+        // level above this one
+        while (filter.size() > aboveRoot + depth()) filter.pop();
+        if (selector.match(elementNode, filter)) result.push_back(elementNode);
+        filter.push(elementNode);
+        return true;
     }
+};
+
+std::vector<ElementNode*> SelectorMatcher::findElements(Node* root, const std::string& selectorStr) {
+    // Parse the selector string to create a Selector object
+    Selector selector(selectorStr);
+
+    // Traverse the DOM and find matching elements
+    MatchCollector collector(selector, root);
+    collector.walk(root);
+    return std::move(collector.result);
+}
 
-    // If the current part is matched, recursively check the next part
-    return matchesCompoundSelector(node, parts, index + 1);
+std::vector<ElementNode*> SelectorMatcher::findElements(Node* root, const std::string& selectorStr, const QueryOptions& options) {
+    Selector selector(selectorStr);
+    return ParallelQuery::collect(root, options, [&selector](ElementNode* element) { return selector.match(element); });
 }
 
-bool SelectorMatcher::matchesPart(Node* node, const SelectorPart& part) {
-    // Match based on the type of selector part
+bool SelectorMatcher::matchesPart(const FlatDocument& document, FlatDocument::Index node, const SelectorPart& part) {
     switch (part.type) {
-    case SelectorType::TAG: {
-        // Check if the node is an ElementNode and its tag matches the selector
-        if (auto elementNode = dynamic_cast<ElementNode*>(node)) {
-            return elementNode->getTagName() == part.value;
-        }
-        break;
-    }
-    case SelectorType::ID: {
-        if (auto elementNode = dynamic_cast<ElementNode*>(node)) {
-            return elementNode->getAttribute("id") == part.value;
-        }
-        break;
-    }
-    case SelectorType::CLASS: {
-        if (auto elementNode = dynamic_cast<ElementNode*>(node)) {
-            return elementNode->getAttribute("class") == part.value;
-        }
-        break;
-    }
-    case SelectorType::ATTRIBUTE: {
-        if (auto elementNode = dynamic_cast<ElementNode*>(node)) {
-            return elementNode->getAttribute(part.attributeName) == part.attributeValue;
+    case SelectorType::TAG:
+        return document.isTag(node, part.name, part.value);
+    case SelectorType::ID:
+        return document.attribute(node, Atoms::id) == part.value;
+    case SelectorType::CLASS:
+        return ClassList::names(document.attribute(node, Atoms::class_), part.value);
+    case SelectorType::ATTRIBUTE:
+        if (part.name == Atoms::Null) {
+            if (part.attributeOperator.empty()) return document.hasAttribute(node, part.attributeName);
+            return document.hasAttribute(node, part.attributeName) && document.attribute(node, part.attributeName) == part.attributeValue;
         }
-        break;
-    }
+        if (part.attributeOperator.empty()) return document.hasAttribute(node, part.name);
+        return document.attribute(node, part.name) == part.attributeValue;
     default:
         return false;
     }
-
-    return false;
 }
 
-std::vector<ElementNode*> SelectorMatcher::findElements(Node* root, const std::string& selectorStr) {
-    std::vector<ElementNode*> result;
-
-    // Parse the selector string to create a Selector object
-    Selector selector(selectorStr);
-
-    // Traverse the DOM and find matching elements
-    std::function<void(Node*)> traverse = [&traverse, &result, &selector](Node* node) {
-        if (!node) return;
+bool SelectorMatcher::matchesCompound(const FlatDocument& document, FlatDocument::Index node, const Selector& selector, size_t begin, size_t end) {
+    const auto& parts = selector.getParts();
+    for (size_t i = begin; i < end; i++) {
+        if (!matchesPart(document, node, parts[i])) return false;
+    }
+    return true;
+}
 
-        if (matches(node, selector)) {
-            if (auto elementNode = dynamic_cast<ElementNode*>(node)) {
-                result.push_back(elementNode);
-            }
-        }
+// As Selector::match, stepping up the parent array; ancestors are a few
+// array reads apart here, so there is no filter
+bool SelectorMatcher::matchesAncestors(const FlatDocument& document, FlatDocument::Index node, const Selector& selector, size_t combinator) {
+    size_t begin = selector.compoundStart(combinator);
+    bool child = selector.getParts()[combinator].type == SelectorType::CHILD;
 
-        // Traverse the children of the node
-        for (auto& child : node->getChildren()) {
-            traverse(child);
-        }
-        };
+    for (FlatDocument::Index ancestor = document.parent(node); ancestor != FlatDocument::none; ancestor = document.parent(ancestor)) {
+        if (matchesCompound(document, ancestor, selector, begin, combinator)
+            && (begin == 0 || matchesAncestors(document, ancestor, selector, begin - 1))) return true;
+        if (child) return false;
+    }
+    return false;
+}
 
-    traverse(root);  // Start traversal from the root node
+std::vector<FlatDocument::Index> SelectorMatcher::findElements(const FlatDocument& document, const std::string& selectorStr) {
+    std::vector<FlatDocument::Index> result;
+    Selector selector(selectorStr);
+    size_t end = selector.getParts().size();
+    size_t subject = selector.compoundStart(end);
 
+    for (FlatDocument::Index node = 0; node < document.size(); node++) {
+        if (!document.isElement(node)) continue;
+        if (!matchesCompound(document, node, selector, subject, end)) continue;
+        if (subject == 0 || matchesAncestors(document, node, selector, subject - 1)) result.push_back(node);
+    }
     return result;
-}
+}
\ No newline at end of file
@@ -2,14 +2,24 @@
 #pragma once
 #include "selector.h"
 #include "node.h"
+#include "flat_document.h"
+#include "parallel_query.h"
 #include <vector>
 
 class SelectorMatcher {
 public:
     static bool matches(Node* node, const Selector& selector);
+    // Keeps an AncestorFilter of the walk's ancestors when the selector has
+    // combinators
     static std::vector<ElementNode*> findElements(Node* root, const std::string& selectorStr);
+    // Same results, matched on options.threads threads once the tree is
+    // large enough (see ParallelQuery); combinators walk up without a filter
+    static std::vector<ElementNode*> findElements(Node* root, const std::string& selectorStr, const QueryOptions& options);
+    // Same over a FlatDocument, returning node indices in document order
+    static std::vector<FlatDocument::Index> findElements(const FlatDocument& document, const std::string& selectorStr);
 
 private:
-    static bool matchesPart(Node* node, const SelectorPart& part);
-    static bool matchesCompoundSelector(Node* node, const std::vector<SelectorPart>& parts, size_t index);
+    static bool matchesPart(const FlatDocument& document, FlatDocument::Index node, const SelectorPart& part);
+    static bool matchesCompound(const FlatDocument& document, FlatDocument::Index node, const Selector& selector, size_t begin, size_t end);
+    static bool matchesAncestors(const FlatDocument& document, FlatDocument::Index node, const Selector& selector, size_t combinator);
 };
\ No newline at end of file
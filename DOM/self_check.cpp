@@ -0,0 +1,221 @@
+#include "self_check.h"
+#include "parser.h"
+#include "document.h"
+#include "serializer.h"
+#include "dom_util.h"
+#include "selector_matcher.h"
+#include "flat_document.h"
+#include "node_traversal.h"
+#include "allocation_counter.h"
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Reports a failed expectation; returns ok so checks can chain
+static bool expect(bool ok, const char* check, const char* what) {
+    if (!ok) std::cerr << "Self-check " << check << " failed: " << what << "\n";
+    return ok;
+}
+
+bool SelfCheck::run() {
+    bool passed = true;
+    passed &= cloneSharing();
+    passed &= escapeRoundTrip();
+    passed &= selectorReuse();
+    passed &= mixedOwnership();
+    passed &= readsAllocateNothing();
+    passed &= unlistedNames();
+    std::cout << (passed ? "All self-checks passed\n" : "Some self-checks failed\n");
+    return passed;
+}
+
+// Replaces the references the Serializer writes with the characters they
+// stand for; the parser keeps them as written
+static std::string decodeEscapes(std::string_view text) {
+    static const struct { const char* reference; char character; } escapes[] = {
+        { "&amp;", '&' }, { "&lt;", '<' }, { "&gt;", '>' }, { "&quot;", '"' },
+    };
+    std::string result;
+    for (size_t i = 0; i < text.size(); i++) {
+        bool replaced = false;
+        for (const auto& escape : escapes) {
+            std::string_view reference(escape.reference);
+            if (text.substr(i, reference.size()) == reference) {
+                result += escape.character;
+                i += reference.size() - 1;
+                replaced = true;
+                break;
+            }
+        }
+        if (!replaced) result += text[i];
+    }
+    return result;
+}
+
+bool SelfCheck::cloneSharing() {
+    static const char* name = "cloneSharing";
+    auto document = DOMParser::parseDocument("<ul class=\"menu\"><li>One</li><li>Two</li></ul>");
+    ElementNode* source = document->getRoot();
+    std::string original = Serializer::toString(source);
+    bool ok = true;
+
+    std::unique_ptr<Node> first(source->clone());
+    std::unique_ptr<Node> second(source->clone());
+    const FlatDocument* snapshot = source->getSnapshot();
+    ok &= expect(snapshot != nullptr, name, "the template keeps no snapshot");
+    ok &= expect(static_cast<ElementNode*>(first.get())->getSnapshot() == snapshot
+        && static_cast<ElementNode*>(second.get())->getSnapshot() == snapshot, name, "two clones have different snapshots");
+    std::unique_ptr<Node> third(second->clone());
+    ok &= expect(static_cast<ElementNode*>(third.get())->getSnapshot() == snapshot, name,
+        "a clone of a clone has a different snapshot");
+
+    // A change deep in the template invalidates it up to the root
+    Node* text = source;
+    while (text && text->nodeType() != NodeType::Text) text = text->getFirstChild();
+    if (!expect(text != nullptr, name, "the template has no text")) return false;
+    static_cast<TextNode*>(text)->setContent("First");
+    std::unique_ptr<Node> edited(source->clone());
+    ok &= expect(static_cast<ElementNode*>(edited.get())->getSnapshot() != snapshot, name,
+        "a clone after an edit reuses the old snapshot");
+    ok &= expect(Serializer::toString(edited.get()) == Serializer::toString(source), name,
+        "a clone after an edit misses the edit");
+
+    // Clones outlive the document they were taken from
+    document.reset();
+    ok &= expect(Serializer::toString(first.get()) == original && Serializer::toString(third.get()) == original, name,
+        "clones changed with their template");
+    return ok;
+}
+
+bool SelfCheck::escapeRoundTrip() {
+    static const char* name = "escapeRoundTrip";
+    ElementNode paragraph("p");
+    paragraph.setAttribute("title", "&amp; \"quoted\"");
+    TextNode* text = new TextNode("");
+    text->setContent("&lt;");
+    paragraph.appendChild(text);
+
+    std::string written = Serializer::toString(&paragraph);
+    bool ok = expect(written == "<p title=\"&amp;amp; &quot;quoted&quot;\">&amp;lt;</p>", name,
+        "an escaped write kept a reference unescaped");
+
+    auto document = DOMParser::parseDocument(written);
+    std::vector<ElementNode*> found = DOMUtil::getElementsByTagName(document->getRoot(), "p");
+    if (!expect(found.size() == 1 && found[0]->hasChildNodes(), name, "the written paragraph did not parse")) return false;
+    const TextNode* parsed = nodeCast<TextNode>(found[0]->getFirstChild());
+    ok &= expect(parsed && decodeEscapes(parsed->getContent()) == "&lt;", name, "the text did not read back as set");
+    ok &= expect(decodeEscapes(found[0]->getAttribute("title")) == "&amp; \"quoted\"", name,
+        "the attribute did not read back as set");
+
+    // Unescaped, as parsed: references stay as they were written
+    ok &= expect(found[0]->toString() == written, name, "the parsed paragraph is not written as parsed");
+    return ok;
+}
+
+bool SelfCheck::selectorReuse() {
+    static const char* name = "selectorReuse";
+    Selector selector("x-reused > p[data-reused=yes]");
+    auto document = DOMParser::parseDocument("<x-reused><p data-reused=\"yes\">A</p><p>B</p></x-reused>");
+    std::vector<ElementNode*> paragraphs = DOMUtil::getElementsByTagName(document->getRoot(), "p");
+    bool ok = expect(paragraphs.size() == 2, name, "the paragraphs were not parsed");
+    ok &= expect(ok && selector.match(paragraphs[0]) && !selector.match(paragraphs[1]), name,
+        "a selector built before the document does not match it");
+    return ok;
+}
+
+bool SelfCheck::mixedOwnership() {
+    static const char* name = "mixedOwnership";
+    Document document;
+    Document other;
+    ElementNode* root = document.getRoot();
+    ElementNode* item = document.createElement("li");
+    root->appendChild(item);
+    bool ok = true;
+
+    std::unique_ptr<ElementNode> heap(new ElementNode("li"));
+    root->appendChild(heap.get());
+    ok &= expect(heap->getParent() == nullptr, name, "a heap node was appended to a document");
+    ok &= expect(root->insertBefore(heap.get(), item) == nullptr && heap->getParent() == nullptr, name,
+        "a heap node was inserted into a document");
+    NodeHandle replaced = root->replaceChild(heap.get(), item);
+    ok &= expect(!replaced && item->getParent() == root && heap->getParent() == nullptr, name,
+        "a heap node replaced a document's node");
+
+    // The refused handle releases its node as any dropped handle does
+    root->appendChild(NodeHandle(heap.release()));
+    ok &= expect(root->getChildren().size() == 1, name, "a heap node was appended through a handle");
+
+    ElementNode* arena = document.createElement("li");
+    ElementNode heapParent("ul");
+    heapParent.appendChild(arena);
+    ok &= expect(arena->getParent() == nullptr && !heapParent.hasChildNodes(), name,
+        "a document's node was appended to a heap node");
+    other.getRoot()->appendChild(arena);
+    ok &= expect(arena->getParent() == nullptr, name, "a node was appended to another document");
+    return ok;
+}
+
+bool SelfCheck::readsAllocateNothing() {
+    static const char* name = "readsAllocateNothing";
+    if (!AllocationCounter::enabled()) return true;
+    auto document = DOMParser::parseDocument(
+        "<div id=\"main\" class=\"nav wide\"><a href=\"/\" class=\"link\">Home</a><p>Text</p></div>");
+    std::vector<ElementNode*> elements;
+    for (Node* node : preorder(document->getRoot())) {
+        if (auto element = nodeCast<ElementNode>(node)) elements.push_back(element);
+    }
+    // The first look-up of a name that is not predefined sets up the
+    // AtomTable's run-time part, once per process; that is not a read
+    elements.front()->getAttribute("no-such-attribute");
+
+    size_t seen = 0;
+    size_t tagNames = AllocationCounter::during([&] {
+        for (ElementNode* element : elements) seen += element->getTagName().size();
+        });
+    size_t attributes = AllocationCounter::during([&] {
+        for (ElementNode* element : elements) {
+            seen += element->getAttribute("href").size() + element->getAttribute(Atoms::id).size();
+            seen += element->getAttribute("no-such-attribute").size();
+        }
+        });
+    size_t classes = AllocationCounter::during([&] {
+        for (ElementNode* element : elements) seen += element->hasClass("nav") + element->hasClass("missing");
+        });
+
+    bool ok = expect(seen > 0, name, "the document has nothing to read");
+    ok &= expect(tagNames == 0, name, "getTagName allocated");
+    ok &= expect(attributes == 0, name, "getAttribute allocated");
+    ok &= expect(classes == 0, name, "hasClass allocated");
+    return ok;
+}
+
+bool SelfCheck::unlistedNames() {
+    static const char* name = "unlistedNames";
+    for (size_t i = 0; AtomTable::intern("x-filler-" + std::to_string(i)) != Atoms::Null; i++) {}
+    size_t atoms = AtomTable::size();
+
+    std::string html = "<x-unlisted data-unlisted=\"v\" id=\"u\"><b data-other=\"w\">text</b></x-unlisted>";
+    auto document = DOMParser::parseDocument(html);
+    bool ok = expect(AtomTable::size() == atoms, name, "parsing grew a full table");
+    ElementNode* element = DOMUtil::getElementById(document->getRoot(), "u");
+    if (!expect(element != nullptr, name, "the element was not parsed")) return false;
+    ok &= expect(element->getTagAtom() == Atoms::Null && element->getTagName() == "x-unlisted", name, "the tag was lost");
+    ok &= expect(element->getAttribute("data-unlisted") == "v" && element->hasAttribute("data-unlisted"), name,
+        "the attribute was lost");
+    ok &= expect(Serializer::toString(element) == html, name, "the element was not written back as parsed");
+
+    ok &= expect(DOMUtil::getElementsByTagName(document->getRoot(), "x-unlisted").size() == 1
+        && document->getIndex().getElementsByTagName("x-unlisted").size() == 1, name, "the tag is not found");
+    ok &= expect(SelectorMatcher::findElements(document->getRoot(), "x-unlisted [data-other=w]").size() == 1, name,
+        "a selector on the names does not match");
+
+    std::unique_ptr<Node> copy(element->clone());
+    ok &= expect(Serializer::toString(copy.get()) == html, name, "a clone lost the names");
+    FlatDocument flat(element);
+    ok &= expect(flat.tagName(0) == "x-unlisted" && flat.attribute(0, "data-unlisted") == "v"
+        && SelectorMatcher::findElements(flat, "x-unlisted b[data-other]").size() == 1, name,
+        "a FlatDocument lost the names");
+    return ok;
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+#pragma once
+#ifndef SELF_CHECK_H
+#define SELF_CHECK_H
+
+// Checks of behaviour the library promises, run by starting the demo with
+// --self-check. Each check reports what went wrong on std::cerr and returns
+// false; run() goes through all of them.
+class SelfCheck {
+public:
+    // True if every check passed
+    static bool run();
+
+    // Clones of one parsed template share a single snapshot, and a change
+    // to the template makes the next clone take a fresh one
+    static bool cloneSharing();
+    // Text and attribute values set through the API, references included,
+    // survive an escaped write and a parse
+    static bool escapeRoundTrip();
+    // A Selector built before any document used its names matches the
+    // documents parsed after it
+    static bool selectorReuse();
+    // Heap and arena nodes are never linked into each other's trees, nor
+    // nodes into another document's
+    static bool mixedOwnership();
+    // getTagName, getAttribute and hasClass make no heap allocation; only
+    // checked in builds that count them (see AllocationCounter)
+    static bool readsAllocateNothing();
+    // Names past the AtomTable's limit stay with their elements and work
+    // as any other; run last, as it leaves the table full
+    static bool unlistedNames();
+};
+
+#endif // SELF_CHECK_H
\ No newline at end of file
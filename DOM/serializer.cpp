@@ -0,0 +1,379 @@
+#include "serializer.h"
+#include "worker_pool.h"
+#include <algorithm>
+#include <vector>
+#include <string_view>
+#include <thread>
+#include <atomic>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/uio.h>
+#include <climits>
+#endif
+
+// Subtrees a parallel write aims to cut per thread, so that threads which
+// drew small ones can pick up more
+static const size_t SUBTREES_PER_THREAD = 8;
+// Levels a parallel write cuts at most; a long chain of only children gains
+// nothing from being cut further
+static const size_t MAX_CUT_DEPTH = 32;
+
+// Output that only counts bytes, for measure()
+struct CountingOutput {
+    size_t size = 0;
+
+    void append(std::string_view text) { size += text.size(); }
+    void push(char) { size++; }
+    bool checkpoint() { return true; }
+};
+
+struct StringOutput {
+    std::string& text;
+
+    void append(std::string_view part) { text.append(part.data(), part.size()); }
+    void push(char c) { text.push_back(c); }
+    bool checkpoint() { return true; }
+};
+
+// Collects output in a buffer and hands it to flush whenever it passes the
+// threshold; checkpoint() reports whether every flush so far succeeded
+template <typename Flush>
+struct FlushingOutput {
+    std::string& buffer;
+    Flush flush;
+    bool ok = true;
+
+    void append(std::string_view part) { buffer.append(part.data(), part.size()); }
+    void push(char c) { buffer.push_back(c); }
+    bool checkpoint() {
+        if (buffer.size() >= Serializer::FLUSH_THRESHOLD) finish();
+        return ok;
+    }
+    bool finish() {
+        if (ok && !buffer.empty()) ok = flush(std::string_view(buffer));
+        buffer.clear();
+        return ok;
+    }
+};
+
+template <typename Flush>
+static FlushingOutput<Flush> flushingOutput(std::string& buffer, Flush flush) {
+    return FlushingOutput<Flush>{ buffer, flush };
+}
+
+// Copies text, replacing the characters markup would misread; runs without
+// any are appended whole. Every '&' is escaped, one that looks like a
+// reference included, so text set to "&lt;" reads back as "&lt;".
+template <typename Output>
+static void appendEscaped(std::string_view text, bool attribute, Output& out) {
+    const char* special = attribute ? "&\"" : "&<>";
+    size_t start = 0;
+    size_t pos;
+    while ((pos = text.find_first_of(special, start)) != std::string_view::npos) {
+        out.append(text.substr(start, pos - start));
+        switch (text[pos]) {
+        case '&': out.append("&amp;"); break;
+        case '<': out.append("&lt;"); break;
+        case '>': out.append("&gt;"); break;
+        default: out.append("&quot;"); break;
+        }
+        start = pos + 1;
+    }
+    out.append(text.substr(start));
+}
+
+Serializer::Serializer(const SerializeOptions& options) : options(options) {}
+
+template <typename Output>
+void Serializer::writeLineStart(size_t depth, Output& out) const {
+    out.push('\n');
+    for (size_t i = depth * options.indentWidth; i > 0; i--) out.push(' ');
+}
+
+template <typename Output>
+void Serializer::writeOpen(const Node* node, Output& out) const {
+    switch (node->nodeType()) {
+    case NodeType::Element:
+    {
+        const ElementNode* element = static_cast<const ElementNode*>(node);
+        std::string_view tag = element->getTagName();
+        out.push('<');
+        out.append(tag);
+
+        auto writeAttribute = [&](std::string_view name, const DOMString& value) {
+            out.push(' ');
+            out.append(name);
+            out.append("=\"");
+            if (options.escape) appendEscaped(value.view(), true, out);
+            else out.append(value.view());
+            out.push('"');
+        };
+
+        // Attributes serialize in name order. Predefined atoms are numbered
+        // alphabetically, so atom order only needs sorting once a run-time
+        // name, or a name without an atom, is among them.
+        const AttributeMap& attributes = element->getAttributes();
+        const ElementNode::UnlistedAttributes& unlisted = element->getUnlistedAttributes();
+        if (unlisted.empty() && (attributes.empty() || AtomTable::isPredefined((attributes.end() - 1)->name))) {
+            for (const auto& attr : attributes) writeAttribute(AtomTable::name(attr.name), attr.value);
+        }
+        else {
+            std::vector<std::pair<std::string_view, const DOMString*>> ordered;
+            ordered.reserve(attributes.size() + unlisted.size());
+            for (const auto& attr : attributes) ordered.push_back({ AtomTable::name(attr.name), &attr.value });
+            for (const auto& attr : unlisted) ordered.push_back({ attr.name.view(), &attr.value });
+            std::sort(ordered.begin(), ordered.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+            for (const auto& attr : ordered) writeAttribute(attr.first, *attr.second);
+        }
+
+        if (element->hasChildNodes()) out.push('>');
+        else out.append("/>");
+    }
+    break;
+    case NodeType::Text:
+    {
+        std::string_view content = static_cast<const TextNode*>(node)->getContent();
+        if (options.escape) appendEscaped(content, false, out);
+        else out.append(content);
+    }
+    break;
+    case NodeType::CDATA:
+        out.append("<![CDATA[");
+        out.append(static_cast<const CDATANode*>(node)->getContent());
+        out.append("]]>");
+        break;
+    }
+}
+
+template <typename Output>
+void Serializer::writeClose(const ElementNode* element, size_t depth, Output& out) const {
+    if (options.pretty) writeLineStart(depth, out);
+    out.append("</");
+    out.append(element->getTagName());
+    out.push('>');
+}
+
+template <typename Output>
+void Serializer::writeTree(const Node* root, size_t depth, Output& out) const {
+    if (!root) return;
+
+    // Pre-order through the links: descend into children, and once a
+    // subtree is done close its elements on the way back up to a sibling
+    const Node* node = root;
+    for (;;) {
+        if (options.pretty && depth > 0) writeLineStart(depth, out);
+        writeOpen(node, out);
+        if (node->nodeType() == NodeType::Element && node->hasChildNodes()) {
+            node = node->getFirstChild();
+            depth++;
+            continue;
+        }
+
+        while (node != root && !node->getNextSibling()) {
+            node = node->getParent();
+            depth--;
+            writeClose(static_cast<const ElementNode*>(node), depth, out);
+        }
+        if (node == root || !out.checkpoint()) break;
+        node = node->getNextSibling();
+    }
+}
+
+// One stretch of a parallel write: a subtree left to a worker, or the open
+// or close tag of an element that was cut into its children
+struct Segment {
+    const Node* subtree;                    // null for tags
+    size_t depth;
+    std::string output;
+};
+
+// Whether the subtree of root has at least count nodes; walks no further
+// than the count-th node
+static bool hasAtLeast(const Node* root, size_t count) {
+    const Node* node = root;
+    for (size_t seen = 1; seen < count; seen++) {
+        if (node->hasChildNodes()) {
+            node = node->getFirstChild();
+            continue;
+        }
+        while (node != root && !node->getNextSibling()) node = node->getParent();
+        if (node == root) return false;
+        node = node->getNextSibling();
+    }
+    return true;
+}
+
+unsigned Serializer::threadCount(const Node* node) const {
+    unsigned threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    if (threads < 2 || !node || !hasAtLeast(node, options.minParallelNodes)) return 1;
+    return threads;
+}
+
+std::vector<std::string> Serializer::renderParallel(const Node* root, unsigned threads) const {
+    // Cut subtrees open level by level, in document order, until there are
+    // enough to go round or nothing is left to cut
+    std::vector<Segment> segments;
+    segments.push_back({ root, 0, std::string() });
+    size_t subtrees = 1;
+    size_t wanted = threads * SUBTREES_PER_THREAD;
+    bool cut = true;
+    for (size_t level = 0; subtrees < wanted && cut && level < MAX_CUT_DEPTH; level++) {
+        cut = false;
+        std::vector<Segment> next;
+        for (auto& segment : segments) {
+            const Node* node = segment.subtree;
+            if (subtrees >= wanted || !node || node->nodeType() != NodeType::Element || !node->hasChildNodes()) {
+                next.push_back(std::move(segment));
+                continue;
+            }
+            Segment open{ nullptr, segment.depth, std::string() };
+            StringOutput openOutput{ open.output };
+            if (options.pretty && segment.depth > 0) writeLineStart(segment.depth, openOutput);
+            writeOpen(node, openOutput);
+            next.push_back(std::move(open));
+            subtrees--;
+            for (const Node* child : node->getChildren()) {
+                next.push_back({ child, segment.depth + 1, std::string() });
+                subtrees++;
+            }
+            Segment close{ nullptr, segment.depth, std::string() };
+            StringOutput closeOutput{ close.output };
+            writeClose(static_cast<const ElementNode*>(node), segment.depth, closeOutput);
+            next.push_back(std::move(close));
+            cut = true;
+        }
+        segments = std::move(next);
+    }
+
+    // Subtrees are disjoint, so workers only ever touch nodes of their own
+    std::atomic<size_t> nextSegment(0);
+    auto work = [&] {
+        for (size_t i = nextSegment++; i < segments.size(); i = nextSegment++) {
+            Segment& segment = segments[i];
+            if (!segment.subtree) continue;
+            if (options.presize) {
+                CountingOutput size;
+                writeTree(segment.subtree, segment.depth, size);
+                segment.output.reserve(size.size);
+            }
+            StringOutput output{ segment.output };
+            writeTree(segment.subtree, segment.depth, output);
+        }
+    };
+    unsigned helpers = static_cast<unsigned>(std::min<size_t>(threads, subtrees)) - 1;
+    WorkerPool::shared().run(helpers, [&](unsigned) { work(); });
+
+    std::vector<std::string> pieces;
+    pieces.reserve(segments.size());
+    for (auto& segment : segments) {
+        if (!segment.output.empty()) pieces.push_back(std::move(segment.output));
+    }
+    return pieces;
+}
+
+void Serializer::write(const Node* node, std::string& out) {
+    unsigned threads = threadCount(node);
+    if (threads > 1) {
+        std::vector<std::string> pieces = renderParallel(node, threads);
+        size_t total = out.size();
+        for (const auto& piece : pieces) total += piece.size();
+        out.reserve(total);
+        for (const auto& piece : pieces) out += piece;
+        return;
+    }
+    if (options.presize) out.reserve(out.size() + measure(node));
+    StringOutput output{ out };
+    writeTree(node, 0, output);
+}
+
+bool Serializer::write(const Node* node, std::ostream& out) {
+    unsigned threads = threadCount(node);
+    if (threads > 1) {
+        for (const auto& piece : renderParallel(node, threads)) {
+            out.write(piece.data(), static_cast<std::streamsize>(piece.size()));
+        }
+        return out.good();
+    }
+    auto output = flushingOutput(buffer, [&out](std::string_view data) {
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        return out.good();
+        });
+    writeTree(node, 0, output);
+    return output.finish();
+}
+
+// Writes all of data to fd, resuming after short writes
+static bool writeAll(int fd, std::string_view data) {
+    while (!data.empty()) {
+#ifdef _WIN32
+        int written = _write(fd, data.data(), static_cast<unsigned int>(data.size()));
+#else
+        ssize_t written = ::write(fd, data.data(), data.size());
+#endif
+        if (written <= 0) return false;
+        data.remove_prefix(static_cast<size_t>(written));
+    }
+    return true;
+}
+
+#ifndef _WIN32
+// Gathers the pieces into as few writev() calls as IOV_MAX allows
+static bool writePieces(int fd, const std::vector<std::string>& pieces) {
+    std::vector<iovec> vectors;
+    size_t first = 0;
+    while (first < pieces.size()) {
+        size_t count = std::min<size_t>(pieces.size() - first, IOV_MAX);
+        vectors.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            vectors[i].iov_base = const_cast<char*>(pieces[first + i].data());
+            vectors[i].iov_len = pieces[first + i].size();
+        }
+        ssize_t written = ::writev(fd, vectors.data(), static_cast<int>(count));
+        if (written < 0) return false;
+        // Finish a short write piece by piece
+        size_t done = static_cast<size_t>(written);
+        for (size_t i = 0; i < count; i++) {
+            const std::string& piece = pieces[first + i];
+            if (done >= piece.size()) {
+                done -= piece.size();
+                continue;
+            }
+            if (!writeAll(fd, std::string_view(piece).substr(done))) return false;
+            done = 0;
+        }
+        first += count;
+    }
+    return true;
+}
+#else
+static bool writePieces(int fd, const std::vector<std::string>& pieces) {
+    for (const auto& piece : pieces) {
+        if (!writeAll(fd, piece)) return false;
+    }
+    return true;
+}
+#endif
+
+bool Serializer::write(const Node* node, int fd) {
+    unsigned threads = threadCount(node);
+    if (threads > 1) return writePieces(fd, renderParallel(node, threads));
+
+    auto output = flushingOutput(buffer, [fd](std::string_view data) { return writeAll(fd, data); });
+    writeTree(node, 0, output);
+    return output.finish();
+}
+
+size_t Serializer::measure(const Node* node) const {
+    CountingOutput output;
+    writeTree(node, 0, output);
+    return output.size;
+}
+
+std::string Serializer::toString(const Node* node, const SerializeOptions& options) {
+    std::string result;
+    Serializer(options).write(node, result);
+    return result;
+}
\ No newline at end of file
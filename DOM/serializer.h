@@ -0,0 +1,83 @@
+#pragma once
+#ifndef SERIALIZER_H
+#define SERIALIZER_H
+
+#include "node.h"
+#include <string>
+#include <ostream>
+#include <vector>
+#include <cstddef>
+
+struct SerializeOptions {
+    // Escape &, < and > in text and & and " in attribute values, so text and
+    // values set through the API read back as set. The parser keeps
+    // character references as written, so parsed documents are reproduced
+    // as parsed only with escaping off, as Node::toString() writes them.
+    bool escape = true;
+    // Put every node on its own line, indented by indentWidth per level
+    bool pretty = false;
+    unsigned indentWidth = 2;
+    // Size the output string exactly with a counting pass before writing,
+    // so it is allocated once (in parallel mode, each subtree's buffer)
+    bool presize = false;
+    // Threads serializing subtrees side by side; 0 uses every hardware
+    // thread. The output is byte for byte the same as with one thread.
+    unsigned threads = 1;
+    // Nodes a subtree needs before a write uses more than one thread, so
+    // small writes never pay for cutting the tree and waking the others
+    size_t minParallelNodes = 16384;
+};
+
+// Writes markup for a node and its subtree straight into an output buffer,
+// in one pass over the tree. Unlike the old recursive toString() no string
+// is built per element, so every byte is copied once whatever the depth.
+// The walk follows parent and sibling links and needs no stack.
+//
+// A Serializer can be reused: writes to a stream or file descriptor go
+// through its internal buffer, which keeps its capacity between calls and
+// is flushed every FLUSH_THRESHOLD bytes.
+//
+// With several threads and at least minParallelNodes nodes, the tree is cut
+// into independent subtrees, from the root's children down as far as needed
+// for a few per thread. Threads from a pool shared between writes take
+// subtrees in turn and render each into a buffer of its own; the buffers
+// and the tags of the elements that were cut open are then joined in
+// document order, or handed to writev() for a file descriptor.
+class Serializer {
+private:
+    SerializeOptions options;
+    std::string buffer;
+
+    // depth is that of root below the node the whole write started at
+    template <typename Output>
+    void writeTree(const Node* root, size_t depth, Output& out) const;
+    template <typename Output>
+    void writeOpen(const Node* node, Output& out) const;
+    template <typename Output>
+    void writeClose(const ElementNode* element, size_t depth, Output& out) const;
+    template <typename Output>
+    void writeLineStart(size_t depth, Output& out) const;
+
+    // The output of a parallel write as consecutive pieces
+    std::vector<std::string> renderParallel(const Node* root, unsigned threads) const;
+    // Threads to write node with; 1 for small subtrees
+    unsigned threadCount(const Node* node) const;
+
+public:
+    static const size_t FLUSH_THRESHOLD = 64 * 1024;
+
+    explicit Serializer(const SerializeOptions& options = SerializeOptions());
+
+    // Appends the markup of node to out
+    void write(const Node* node, std::string& out);
+    // Stream and descriptor output; false if writing failed
+    bool write(const Node* node, std::ostream& out);
+    bool write(const Node* node, int fd);
+
+    // Exact number of bytes write() produces for node
+    size_t measure(const Node* node) const;
+
+    static std::string toString(const Node* node, const SerializeOptions& options = SerializeOptions());
+};
+
+#endif // SERIALIZER_H
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include "structural_index.h"
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define DOM_SCAN_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DOM_SCAN_SSE2
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static const char STRUCTURAL_CHARS[] = { '<', '>', '"', '=' };
+
+static inline unsigned trailingZeros(uint64_t mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctzll(mask));
+#endif
+}
+
+// Appends offset + bit for every set bit of mask
+static inline size_t appendOffsets(uint16_t* list, size_t count, size_t offset, uint64_t mask) {
+    while (mask) {
+        list[count++] = static_cast<uint16_t>(offset + trailingZeros(mask));
+        mask &= mask - 1;
+    }
+    return count;
+}
+
+StructuralIndex::StructuralIndex(std::string_view text, Scanner scanner)
+    : text(text), scanner(scanner), windowBegin(0), windowEnd(0),
+    offsets(CLASS_COUNT * WINDOW_SIZE), counts(), cursors() {
+}
+
+void StructuralIndex::reset(std::string_view newText) {
+    text = newText;
+    windowBegin = 0;
+    windowEnd = 0;
+}
+
+const char* StructuralIndex::vectorBackend() {
+#if defined(DOM_SCAN_AVX2)
+    return "AVX2";
+#elif defined(DOM_SCAN_SSE2)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+size_t StructuralIndex::findUnindexed(char c, size_t from, size_t end) const {
+    size_t found = text.find(c, from);
+    return (found == std::string_view::npos || found >= end) ? npos : found;
+}
+
+void StructuralIndex::refill(size_t from) {
+    windowBegin = from & ~static_cast<size_t>(63);
+    windowEnd = std::min(windowBegin + WINDOW_SIZE, text.size());
+    std::fill(std::begin(counts), std::end(counts), 0);
+    std::fill(std::begin(cursors), std::end(cursors), 0);
+    if (scanner == Scanner::Vector) scanVector();
+    else scanScalar(windowBegin);
+}
+
+void StructuralIndex::scanScalar(size_t begin) {
+    for (size_t i = begin; i < windowEnd; i++) {
+        for (int cls = 0; cls < CLASS_COUNT; cls++) {
+            if (text[i] == STRUCTURAL_CHARS[cls]) {
+                offsets[cls * WINDOW_SIZE + counts[cls]++] = static_cast<uint16_t>(i - windowBegin);
+                break;
+            }
+        }
+    }
+}
+
+void StructuralIndex::scanVector() {
+    const char* data = text.data();
+    size_t i = windowBegin;
+
+#if defined(DOM_SCAN_AVX2)
+    __m256i needles[CLASS_COUNT];
+    for (int cls = 0; cls < CLASS_COUNT; cls++) needles[cls] = _mm256_set1_epi8(STRUCTURAL_CHARS[cls]);
+    for (; i + 64 <= windowEnd; i += 64) {
+        __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 32));
+        for (int cls = 0; cls < CLASS_COUNT; cls++) {
+            uint64_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, needles[cls])))
+                | static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, needles[cls])))) << 32;
+            counts[cls] = appendOffsets(&offsets[cls * WINDOW_SIZE], counts[cls], i - windowBegin, mask);
+        }
+    }
+#elif defined(DOM_SCAN_SSE2)
+    __m128i needles[CLASS_COUNT];
+    for (int cls = 0; cls < CLASS_COUNT; cls++) needles[cls] = _mm_set1_epi8(STRUCTURAL_CHARS[cls]);
+    for (; i + 64 <= windowEnd; i += 64) {
+        __m128i chunks[4];
+        for (int quarter = 0; quarter < 4; quarter++) {
+            chunks[quarter] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + quarter * 16));
+        }
+        for (int cls = 0; cls < CLASS_COUNT; cls++) {
+            uint64_t mask = 0;
+            for (int quarter = 0; quarter < 4; quarter++) {
+                uint32_t bits = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunks[quarter], needles[cls])));
+                mask |= static_cast<uint64_t>(bits) << (quarter * 16);
+            }
+            counts[cls] = appendOffsets(&offsets[cls * WINDOW_SIZE], counts[cls], i - windowBegin, mask);
+        }
+    }
+#else
+    (void)data;
+#endif
+
+    scanScalar(i);
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+#ifndef STRUCTURAL_INDEX_H
+#define STRUCTURAL_INDEX_H
+
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// First tokenizer pass over the source.
+//
+// Classifies the bytes the parser dispatches on ('<', '>', '"' and '=') and
+// records their offsets in one sorted list per character, so the parser
+// walks this index instead of issuing a fresh std::string::find per token
+// and each byte of the input is examined once. Input is classified 64 bytes
+// at a time with AVX2 or SSE2 when the build targets them, with a scalar
+// loop for the tail and other targets.
+//
+// The index covers a sliding window of WINDOW_SIZE bytes that is refilled as
+// the parser advances, so it stays cache-resident and never allocates in
+// proportion to the document.
+class StructuralIndex {
+public:
+    enum class Scanner {
+        Scalar,     // byte-at-a-time classification
+        Vector      // best SIMD backend available to this build
+    };
+
+    static const size_t npos = static_cast<size_t>(-1);
+    static const size_t WINDOW_SIZE = 4096;
+
+    explicit StructuralIndex(std::string_view text, Scanner scanner = Scanner::Vector);
+
+    // Starts over on new text, reusing the window buffer
+    void reset(std::string_view newText);
+
+    // Position of the first c at or after from and before end, or npos.
+    // Calls are cheapest when from never decreases, which is how the parser
+    // walks the document.
+    size_t find(char c, size_t from, size_t end = npos) {
+        int cls = classOf(c);
+        if (cls < 0) return findUnindexed(c, from, end);
+        while (true) {
+            if (from < windowBegin || from >= windowEnd) {
+                if (from >= text.size()) return npos;
+                refill(from);
+            }
+            const uint16_t* list = &offsets[cls * WINDOW_SIZE];
+            size_t& cursor = cursors[cls];
+            size_t offset = from - windowBegin;
+            if (cursor > 0 && list[cursor - 1] >= offset) cursor = 0;
+            while (cursor < counts[cls] && list[cursor] < offset) cursor++;
+            if (cursor < counts[cls]) {
+                size_t found = windowBegin + list[cursor];
+                return found < end ? found : npos;
+            }
+            if (windowEnd >= end) return npos;
+            from = windowEnd;
+        }
+    }
+
+    // Name of the SIMD backend compiled in ("AVX2", "SSE2" or "scalar")
+    static const char* vectorBackend();
+
+private:
+    static const int CLASS_COUNT = 4;    // '<', '>', '"', '='
+
+    std::string_view text;
+    Scanner scanner;
+    size_t windowBegin;
+    size_t windowEnd;
+    std::vector<uint16_t> offsets;      // CLASS_COUNT lists of WINDOW_SIZE entries
+    size_t counts[CLASS_COUNT];
+    size_t cursors[CLASS_COUNT];
+
+    static int classOf(char c) {
+        switch (c) {
+        case '<': return 0;
+        case '>': return 1;
+        case '"': return 2;
+        case '=': return 3;
+        default: return -1;
+        }
+    }
+
+    size_t findUnindexed(char c, size_t from, size_t end) const;
+    // Classifies the window starting at the 64-byte block containing from
+    void refill(size_t from);
+    void scanScalar(size_t begin);
+    void scanVector();
+};
+
+#endif // STRUCTURAL_INDEX_H
\ No newline at end of file
@@ -0,0 +1,89 @@
+#include "tree_builder.h"
+#include "document.h"
+#include <cctype>
+#include <iostream>
+
+// New nodes follow the allocation strategy of the tree they are appended to
+static ElementNode* createElement(Node* parent, std::string_view tagName) {
+    Document* document = parent->getOwnerDocument();
+    return document ? document->createElement(tagName) : new ElementNode(tagName);
+}
+
+static TextNode* createTextNode(Node* parent, std::string_view text) {
+    Document* document = parent->getOwnerDocument();
+    return document ? document->createTextNode(text) : new TextNode(text);
+}
+
+static CDATANode* createCDATASection(Node* parent, std::string_view data) {
+    Document* document = parent->getOwnerDocument();
+    return document ? document->createCDATASection(data) : new CDATANode(data);
+}
+
+// Room for the nesting of typical pages before the stack has to grow
+static const size_t INITIAL_STACK_CAPACITY = 256;
+
+TreeBuilder::TreeBuilder(Node* root, size_t maxDepth, bool buildIndex)
+    : root(root), current(root), maxDepth(maxDepth) {
+    openElements.reserve(INITIAL_STACK_CAPACITY);
+    openPerBucket.fill(0);
+    // Appending indexes whatever goes below an index that is already built
+    Document* document = root->getOwnerDocument();
+    if (buildIndex && document) document->getIndex();
+}
+
+// Case-folded, like the end-tag match itself
+uint8_t TreeBuilder::nameBucket(std::string_view name) {
+    uint32_t hash = 2166136261u;
+    for (char c : name) hash = (hash ^ static_cast<uint8_t>(tolower(static_cast<unsigned char>(c)))) * 16777619u;
+    return static_cast<uint8_t>(hash ^ (hash >> 8) ^ (hash >> 16) ^ (hash >> 24));
+}
+
+void TreeBuilder::updateCurrent() {
+    size_t depth = openElements.size();
+    if (maxDepth > 0 && depth > maxDepth) depth = maxDepth;
+    current = depth ? static_cast<Node*>(openElements[depth - 1].element) : root;
+}
+
+void TreeBuilder::popTo(size_t size) {
+    for (size_t i = size; i < openElements.size(); i++) openPerBucket[openElements[i].bucket]--;
+    openElements.resize(size);
+    updateCurrent();
+}
+
+void TreeBuilder::startElement(std::string_view name, const AttributeList& attributes) {
+    ElementNode* elementNode = createElement(current, name);
+    for (const auto& attr : attributes) {
+        elementNode->setAttribute(attr.first, attr.second);
+    }
+    current->appendChild(elementNode);
+    uint8_t bucket = nameBucket(name);
+    openElements.push_back({ elementNode, bucket });
+    openPerBucket[bucket]++;
+    if (maxDepth > 0 && openElements.size() > maxDepth && !depthExceeded) {
+        std::cerr << "Parser: elements nested deeper than maxDepth (" << maxDepth
+            << ") are appended at that depth" << std::endl;
+        depthExceeded = true;
+    }
+    updateCurrent();
+}
+
+void TreeBuilder::endElement(std::string_view name) {
+    // Stray end tags would otherwise cost a walk down the whole stack each
+    uint8_t bucket = nameBucket(name);
+    if (openPerBucket[bucket] == 0) return;
+
+    for (size_t i = openElements.size(); i > 0; i--) {
+        if (openElements[i - 1].bucket == bucket && openElements[i - 1].element->hasTagName(name)) {
+            popTo(i - 1);
+            return;
+        }
+    }
+}
+
+void TreeBuilder::text(std::string_view content) {
+    current->appendChild(createTextNode(current, content));
+}
+
+void TreeBuilder::cdata(std::string_view content) {
+    current->appendChild(createCDATASection(current, content));
+}
\ No newline at end of file
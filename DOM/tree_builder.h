@@ -0,0 +1,53 @@
+#pragma once
+#ifndef TREE_BUILDER_H
+#define TREE_BUILDER_H
+
+#include "node.h"
+#include "parse_handler.h"
+#include <vector>
+#include <array>
+#include <cstdint>
+
+// The ParseHandler behind DOMParser's tree-building entry points. Open
+// elements are kept on an explicit stack rather than the call stack, so
+// nesting depth costs heap entries, not stack frames. New nodes follow the
+// allocation strategy of root (its Document's arena, or the heap).
+//
+// An end tag closes the innermost open element with that name, along with
+// any elements still open inside it; end tags matching no open element are
+// ignored. Past maxDepth (0 for no limit) elements are still tracked on the
+// stack but appended to the element at maxDepth, keeping the tree shallow;
+// the first time that happens it is reported on std::cerr.
+class TreeBuilder : public ParseHandler {
+private:
+    struct OpenElement {
+        ElementNode* element;
+        uint8_t bucket;                         // nameBucket() of its tag name
+    };
+
+    Node* root;
+    Node* current;                              // where new nodes are appended
+    std::vector<OpenElement> openElements;      // innermost last
+    // Open elements per name bucket; an end tag whose bucket is empty cannot
+    // match and is dropped without scanning the stack
+    std::array<uint32_t, 256> openPerBucket;
+    size_t maxDepth;
+    bool depthExceeded = false;                 // reported once per builder
+
+    static uint8_t nameBucket(std::string_view name);
+    void popTo(size_t size);
+
+    void updateCurrent();
+
+public:
+    // With buildIndex the index of root's document is built up front, so
+    // every element is added to it as it is appended
+    explicit TreeBuilder(Node* root, size_t maxDepth = 0, bool buildIndex = false);
+
+    void startElement(std::string_view name, const AttributeList& attributes) override;
+    void endElement(std::string_view name) override;
+    void text(std::string_view content) override;
+    void cdata(std::string_view content) override;
+};
+
+#endif // TREE_BUILDER_H
\ No newline at end of file
@@ -0,0 +1,64 @@
+#include "worker_pool.h"
+#include <algorithm>
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& thread : threads) thread.join();
+}
+
+WorkerPool& WorkerPool::shared() {
+    static WorkerPool pool;
+    return pool;
+}
+
+void WorkerPool::loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wake.wait(lock, [this] { return stopping || !batches.empty(); });
+        if (stopping) return;
+
+        Batch* batch = batches.front();
+        unsigned index = batch->next++;
+        if (batch->next > batch->last) batches.pop_front();
+        batch->running++;
+
+        lock.unlock();
+        batch->job(index);
+        lock.lock();
+        if (--batch->running == 0) batch->done.notify_all();
+    }
+}
+
+void WorkerPool::start(Batch& batch, unsigned helpers, std::function<void(unsigned)> job) {
+    if (helpers == 0) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        batch.job = std::move(job);
+        batch.next = 1;
+        batch.last = helpers;
+        batch.running = 0;
+        while (threads.size() < helpers) threads.emplace_back([this] { loop(); });
+        batches.push_back(&batch);
+    }
+    wake.notify_all();
+}
+
+void WorkerPool::finish(Batch& batch) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (batch.next <= batch.last) {
+        batches.erase(std::find(batches.begin(), batches.end(), &batch));
+        batch.next = batch.last + 1;
+    }
+    batch.done.wait(lock, [&batch] { return batch.running == 0; });
+}
+
+void WorkerPool::run(unsigned helpers, std::function<void(unsigned)> job) {
+    Batch batch;
+    start(batch, helpers, job);
+    job(0);
+    finish(batch);
+}
\ No newline at end of file
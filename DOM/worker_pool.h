@@ -0,0 +1,66 @@
+#pragma once
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <functional>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Threads kept for the parallel paths, so that a query or a write does not
+// create and join threads of its own. Idle threads sleep on a condition
+// variable until there is work.
+//
+// Work comes in batches: the caller asks for job(1) .. job(helpers) to run
+// on pool threads while it does its own share. Threads take the calls in
+// order as they come free, and the pool grows to the largest number of
+// helpers any batch has asked for. Calls that no thread has begun when the
+// caller finishes the batch are withdrawn, so a caller never waits behind
+// other batches; a job must get its work done whichever calls are made.
+class WorkerPool {
+public:
+    class Batch {
+        friend class WorkerPool;
+
+        std::function<void(unsigned)> job;
+        unsigned next = 1;                  // index of the next call to hand out
+        unsigned last = 0;
+        unsigned running = 0;               // calls begun and not returned
+        std::condition_variable done;
+
+    public:
+        Batch() = default;
+        Batch(const Batch&) = delete;
+        Batch& operator=(const Batch&) = delete;
+    };
+
+private:
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Batch*> batches;             // with calls not handed out yet
+    std::vector<std::thread> threads;
+    bool stopping = false;
+
+    WorkerPool() = default;
+    void loop();
+
+public:
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+    ~WorkerPool();
+
+    // The process-wide pool, started on first use
+    static WorkerPool& shared();
+
+    // Queues job(1) .. job(helpers) and returns at once; batch must stay
+    // alive until finish()
+    void start(Batch& batch, unsigned helpers, std::function<void(unsigned)> job);
+    // Withdraws the calls of batch no thread has begun and waits for the rest
+    void finish(Batch& batch);
+    // start(), then job(0) on the calling thread, then finish()
+    void run(unsigned helpers, std::function<void(unsigned)> job);
+};
+
+#endif // WORKER_POOL_H
\ No newline at end of file